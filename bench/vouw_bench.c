@@ -0,0 +1,368 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+/* Benchmarks of the generator, the encoder and the decoder over a grid of automata.
+ * Every benchmark is run a number of times after warming up and the statistics of
+ * the timings are written as JSON, so that the results of different commits can be compared.
+ */
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime(), getrusage()
+
+#include "rfca.h"
+#include "ttable.h"
+#include "pattern.h"
+#include "vouw.h"
+#include "cli.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define BENCH_VERSION 1
+#define BENCH_LIST_MAX 16
+#define BENCH_REPEAT 5
+#define BENCH_WARMUP 1
+
+typedef struct {
+    int values[BENCH_LIST_MAX];
+    int count;
+} bench_list_t;
+
+/* The automaton a benchmark runs on, with its encoding */
+typedef struct {
+    rfca_opts_t opts;
+    rfca_t* r;
+    rfca_t* scratch;    // of the same shape, to be regenerated
+    vouw_t* encoded;
+} bench_case_t;
+
+/* Run a benchmark once and return the time of the part that is measured, in seconds.
+ * items is set to the number of nodes (or other items) that were processed. */
+typedef double (*bench_func_t)( bench_case_t* c, uint64_t* items );
+
+typedef struct {
+    const char* name;
+    bench_func_t func;
+} bench_t;
+
+// Keeps results from being optimized away
+static volatile uint64_t bench_sink;
+
+static double
+bench_now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double
+bench_generate( bench_case_t* c, uint64_t* items ) {
+    const double start = bench_now();
+    rfca_reset( c->scratch, c->opts.rule );
+    rfca_generate( c->scratch );
+    const double seconds = bench_now() - start;
+    *items = c->scratch->buffer->nodeCount;
+    return seconds;
+}
+
+static double
+bench_step( bench_case_t* c, uint64_t* items ) {
+    rfca_reset( c->scratch, c->opts.rule );
+    const double start = bench_now();
+    while( step( c->scratch ) );
+    const double seconds = bench_now() - start;
+    *items = c->scratch->buffer->nodeCount;
+    return seconds;
+}
+
+static double
+bench_ttIndex( bench_case_t* c, uint64_t* items ) {
+    const rfca_buffer_t* b = c->r->buffer;
+    uint64_t sum =0;
+    *items =0;
+    const double start = bench_now();
+    for( int i =1; i < b->rowCount; i++ ) {
+        for( int j =0; j < b->rows[i].size; j++ )
+            sum += tt_index( c->opts.base, c->opts.mode, b->rows[i-1].cols + j );
+        *items += b->rows[i].size;
+    }
+    const double seconds = bench_now() - start;
+    bench_sink = sum;
+    return seconds;
+}
+
+static double
+bench_isMatch( bench_case_t* c, uint64_t* items ) {
+    // Match the largest pattern of the encoding at every node
+    const pattern_t* p =NULL;
+    struct list_head* pos;
+    list_for_each( pos, &(c->encoded->codeTable->list) ) {
+        const pattern_t* q = list_entry( pos, pattern_t, list );
+        if( !p || q->size > p->size )
+            p = q;
+    }
+    const rfca_buffer_t* b = c->r->buffer;
+    uint64_t matches =0;
+    const double start = bench_now();
+    for( int i =0; i < b->rowCount; i++ ) {
+        for( int j =0; j < b->rows[i].size; j++ ) {
+            rfca_coord_t pivot = { i, j };
+            int variant;
+            matches += pattern_isMatch( p, c->r, pivot, &variant );
+        }
+    }
+    const double seconds = bench_now() - start;
+    bench_sink = matches;
+    *items = b->nodeCount;
+    return seconds;
+}
+
+static double
+bench_encodeStep( bench_case_t* c, uint64_t* items ) {
+    vouw_t* v = vouw_createFrom( c->r );
+    const double start = bench_now();
+    bench_sink = vouw_encodeStep( v );
+    const double seconds = bench_now() - start;
+    vouw_free( v );
+    *items = c->r->buffer->nodeCount;
+    return seconds;
+}
+
+static double
+bench_encode( bench_case_t* c, uint64_t* items ) {
+    vouw_t* v = vouw_createFrom( c->r );
+    const double start = bench_now();
+    bench_sink = vouw_encode( v );
+    const double seconds = bench_now() - start;
+    vouw_free( v );
+    *items = c->r->buffer->nodeCount;
+    return seconds;
+}
+
+static double
+bench_encodeUsing( bench_case_t* c, uint64_t* items ) {
+    const double start = bench_now();
+    vouw_t* v = vouw_createEncodedUsing( c->r, c->encoded->codeTable );
+    const double seconds = bench_now() - start;
+    vouw_free( v );
+    *items = c->r->buffer->nodeCount;
+    return seconds;
+}
+
+static double
+bench_decode( bench_case_t* c, uint64_t* items ) {
+    const double start = bench_now();
+    rfca_t* r = vouw_decode( c->encoded );
+    const double seconds = bench_now() - start;
+    rfca_free( r );
+    *items = c->r->buffer->nodeCount;
+    return seconds;
+}
+
+static const bench_t BENCHMARKS[] = {
+    { "rfca_generate", bench_generate },
+    { "step", bench_step },
+    { "tt_index", bench_ttIndex },
+    { "pattern_isMatch", bench_isMatch },
+    { "vouw_encodeStep", bench_encodeStep },
+    { "vouw_encode", bench_encode },
+    { "vouw_createEncodedUsing", bench_encodeUsing },
+    { "vouw_decode", bench_decode },
+};
+#define BENCH_COUNT (sizeof( BENCHMARKS ) / sizeof( bench_t ))
+
+static int
+bench_cmpDouble( const void* a, const void* b ) {
+    const double da = *(const double*)a, db = *(const double*)b;
+    return da < db ? -1 : da > db;
+}
+
+/*
+ * Percentile p of n sorted samples, interpolated linearly between the nearest two
+ */
+static double
+bench_percentile( const double* sorted, int n, double p ) {
+    const double x = (n - 1) * p / 100.0;
+    const int i = (int)x;
+    if( i + 1 >= n )
+        return sorted[n-1];
+    return sorted[i] + (sorted[i+1] - sorted[i]) * (x - i);
+}
+
+static long
+bench_peakRss( void ) {
+    struct rusage ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_maxrss; // kilobytes on Linux
+}
+
+static bool
+bench_parseList( const char* spec, bench_list_t* list, int min, int max ) {
+    list->count =0;
+    while( *spec ) {
+        char* end;
+        long v = strtol( spec, &end, 10 );
+        if( end == spec || v < min || v > max || list->count == BENCH_LIST_MAX || (*end != ',' && *end != '\0') )
+            return false;
+        list->values[list->count++] = (int)v;
+        spec = *end ? end + 1 : end;
+    }
+    return list->count > 0;
+}
+
+/*
+ * A rule of the class that is the same on every run, spread over the rulespace
+ */
+static uint64_t
+bench_rule( int mode, int base ) {
+    uint64_t x = (uint64_t)mode * 0x9e3779b97f4a7c15ULL + (uint64_t)base;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    const uint64_t rules = rfca_maxRules( base, mode );
+    return rules ? x % rules : x; // the rulespace does not fit in 64 bits if rfca_maxRules() wraps around to 0
+}
+
+static void
+bench_printHelp( const char* exec ) {
+    fprintf( stderr, "usage: %s [--modes LIST] [--bases LIST] [--inputs LIST] [--folds LIST] [--benchmarks NAMES]\n\
+\t[--repeat N] [--warmup N] [--label NAME] [--out FILE]\n\
+Time the generator, encoder and decoder for every combination of mode, base, input length and folds,\n\
+given as comma-separated lists, and write the statistics as JSON to FILE or the standard output.\n\
+The benchmarks are:", exec );
+    for( size_t i =0; i < BENCH_COUNT; i++ )
+        fprintf( stderr, " %s", BENCHMARKS[i].name );
+    fprintf( stderr, "\n" );
+}
+
+int
+main( int argc, char** argv ) {
+    bench_list_t modes = { { 2, 3 }, 2 };
+    bench_list_t bases = { { 2, 3 }, 2 };
+    bench_list_t inputs = { { 4, 8 }, 2 };
+    bench_list_t folds = { { 8, 16 }, 2 };
+    int repeat =BENCH_REPEAT, warmup =BENCH_WARMUP;
+    const char* benchmarks =NULL;
+    const char* label ="";
+    const char* outPath =NULL;
+
+    for( int i =1; i < argc; i += 2 ) {
+        bool ok = i + 1 < argc;
+        if( ok && strcmp( argv[i], "--modes" ) == 0 )
+            ok = bench_parseList( argv[i+1], &modes, 2, MODE_MAX );
+        else if( ok && strcmp( argv[i], "--bases" ) == 0 )
+            ok = bench_parseList( argv[i+1], &bases, 2, BASE_MAX );
+        else if( ok && strcmp( argv[i], "--inputs" ) == 0 )
+            ok = bench_parseList( argv[i+1], &inputs, 1, INPUT_MAX );
+        else if( ok && strcmp( argv[i], "--folds" ) == 0 )
+            ok = bench_parseList( argv[i+1], &folds, 0, FOLDS_MAX );
+        else if( ok && strcmp( argv[i], "--benchmarks" ) == 0 )
+            benchmarks = argv[i+1];
+        else if( ok && strcmp( argv[i], "--repeat" ) == 0 )
+            ok = (repeat = atoi( argv[i+1] )) > 0;
+        else if( ok && strcmp( argv[i], "--warmup" ) == 0 )
+            ok = (warmup = atoi( argv[i+1] )) >= 0 && strspn( argv[i+1], "0123456789" ) == strlen( argv[i+1] );
+        else if( ok && strcmp( argv[i], "--label" ) == 0 )
+            ok = strpbrk( label = argv[i+1], "\"\\" ) == NULL;
+        else if( ok && strcmp( argv[i], "--out" ) == 0 )
+            outPath = argv[i+1];
+        else
+            ok =false;
+        if( !ok ) {
+            bench_printHelp( argv[0] );
+            return -1;
+        }
+    }
+
+    bool selected[BENCH_COUNT];
+    for( size_t b =0; b < BENCH_COUNT; b++ ) {
+        selected[b] = benchmarks == NULL;
+        if( benchmarks ) {
+            // Names are matched as whole items of the comma-separated list
+            const size_t len = strlen( BENCHMARKS[b].name );
+            for( const char* s = benchmarks; s && *s; s = strchr( s, ',' ) ? strchr( s, ',' ) + 1 : NULL )
+                if( strncmp( s, BENCHMARKS[b].name, len ) == 0 && (s[len] == ',' || s[len] == '\0') )
+                    selected[b] =true;
+        }
+    }
+
+    FILE* out = outPath ? fopen( outPath, "w" ) : stdout;
+    if( !out ) {
+        fprintf( stderr, "Error: Cannot open `%s'\n", outPath );
+        return -1;
+    }
+    fprintf( out, "{\n  \"version\": %d,\n  \"label\": \"%s\",\n  \"repeat\": %d,\n  \"warmup\": %d,\n  \"results\": [",
+        BENCH_VERSION, label, repeat, warmup );
+
+    double* samples = (double*)malloc( sizeof( double ) * repeat );
+    bool first =true;
+    for( int mi =0; mi < modes.count; mi++ )
+    for( int bi =0; bi < bases.count; bi++ )
+    for( int ii =0; ii < inputs.count; ii++ )
+    for( int fi =0; fi < folds.count; fi++ ) {
+        bench_case_t c;
+        c.opts.mode = modes.values[mi];
+        c.opts.base = bases.values[bi];
+        c.opts.rule = bench_rule( c.opts.mode, c.opts.base );
+        c.opts.inputSize = inputs.values[ii];
+        c.opts.folds = folds.values[fi];
+        c.opts.right =false;
+        c.opts.file =NULL;
+        c.opts.input = (rfca_node_t*)malloc( sizeof( rfca_node_t ) * c.opts.inputSize );
+        for( int i =0; i < c.opts.inputSize; i++ )
+            c.opts.input[i] = (rfca_node_t)((i * 7 + 3) * (i + 1) / 2) % c.opts.base;
+
+        c.r = rfca_create( c.opts );
+        rfca_generate( c.r );
+        c.scratch = rfca_create( c.opts );
+        c.encoded = vouw_createFrom( c.r );
+        vouw_encode( c.encoded );
+
+        for( size_t b =0; b < BENCH_COUNT; b++ ) {
+            if( !selected[b] )
+                continue;
+            fprintf( stderr, "%s %d.%d.%"PRIu64" input %d folds %d\n", BENCHMARKS[b].name,
+                c.opts.mode, c.opts.base, c.opts.rule, c.opts.inputSize, c.opts.folds );
+
+            uint64_t items =0;
+            for( int k =0; k < warmup; k++ )
+                BENCHMARKS[b].func( &c, &items );
+            double total =0.0;
+            for( int k =0; k < repeat; k++ ) {
+                samples[k] = BENCHMARKS[b].func( &c, &items );
+                total += samples[k];
+            }
+            qsort( samples, repeat, sizeof( double ), bench_cmpDouble );
+            const double median = bench_percentile( samples, repeat, 50.0 );
+
+            fprintf( out, "%s\n    { \"benchmark\": \"%s\", \"mode\": %d, \"base\": %d, \"rule\": %"PRIu64", "
+                "\"input\": %d, \"folds\": %d, \"nodes\": %d, \"items\": %"PRIu64", "
+                "\"median_s\": %.9g, \"mean_s\": %.9g, \"min_s\": %.9g, \"max_s\": %.9g, "
+                "\"p10_s\": %.9g, \"p90_s\": %.9g, \"p99_s\": %.9g, \"nodes_per_s\": %.6g, \"peak_rss_kb\": %ld }",
+                first ? "" : ",", BENCHMARKS[b].name, c.opts.mode, c.opts.base, c.opts.rule,
+                c.opts.inputSize, c.opts.folds, c.r->buffer->nodeCount, items,
+                median, total / repeat, samples[0], samples[repeat-1],
+                bench_percentile( samples, repeat, 10.0 ), bench_percentile( samples, repeat, 90.0 ),
+                bench_percentile( samples, repeat, 99.0 ),
+                median > 0.0 ? (double)items / median : 0.0, bench_peakRss() );
+            first =false;
+            fflush( out );
+        }
+
+        vouw_free( c.encoded );
+        rfca_free( c.scratch );
+        rfca_free( c.r );
+        free( c.opts.input );
+    }
+    fprintf( out, "\n  ],\n  \"peak_rss_kb\": %ld\n}\n", bench_peakRss() );
+    free( samples );
+    if( out != stdout )
+        fclose( out );
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "bitboard.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int
+rowWords( int size ) {
+    return (size + 63) / 64 + 1;
+}
+
+static uint64_t
+lanemask( int count ) {
+    return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+}
+
+/*
+ * Read the 64 bits starting at column c from a row
+ */
+static inline uint64_t
+extract( const uint64_t* row, int c ) {
+    const int w = c >> 6, s = c & 63;
+    if( !s )
+        return row[w];
+    return (row[w] >> s) | (row[w+1] << (64 - s));
+}
+
+/*
+ * OR bits into a row, with bit 0 of bits ending up at column c
+ */
+static inline void
+deposit( uint64_t* row, int c, uint64_t bits ) {
+    const int w = c >> 6, s = c & 63;
+    row[w] |= bits << s;
+    if( s )
+        row[w+1] |= bits >> (64 - s);
+}
+
+static bitboard_t*
+bitboard_alloc( int rowCount, const int* rowSize, int nodeCount ) {
+    bitboard_t* bb = (bitboard_t*)malloc( sizeof( bitboard_t ) );
+    bb->rowCount = rowCount;
+    bb->nodeCount = nodeCount;
+    bb->rowSize = (int*)malloc( sizeof( int ) * rowCount );
+    bb->rows = (uint64_t**)malloc( sizeof( uint64_t* ) * rowCount );
+
+    bb->words =0;
+    for( int i =0; i < rowCount; i++ )
+        bb->words += rowWords( rowSize[i] );
+    bb->data = (uint64_t*)calloc( bb->words, sizeof( uint64_t ) );
+
+    uint64_t* w = bb->data;
+    for( int i =0; i < rowCount; i++ ) {
+        bb->rowSize[i] = rowSize[i];
+        bb->rows[i] = w;
+        w += rowWords( rowSize[i] );
+    }
+    return bb;
+}
+
+/*
+ * Allocate an all-zero bitboard with the same shape as the given buffer
+ */
+bitboard_t*
+bitboard_create( const rfca_buffer_t* shape ) {
+    int rowSize[shape->rowCount];
+    for( int i =0; i < shape->rowCount; i++ )
+        rowSize[i] = shape->rows[i].size;
+    return bitboard_alloc( shape->rowCount, rowSize, shape->nodeCount );
+}
+
+/*
+ * Allocate an all-zero bitboard with the same shape as bb, to be used as a mask
+ */
+bitboard_t*
+bitboard_createLike( const bitboard_t* bb ) {
+    return bitboard_alloc( bb->rowCount, bb->rowSize, bb->nodeCount );
+}
+
+void
+bitboard_clear( bitboard_t* bb ) {
+    memset( bb->data, 0, bb->words * sizeof( uint64_t ) );
+}
+
+/*
+ * Make a bitboard copy of the base-2 automaton r
+ */
+bitboard_t*
+bitboard_createFrom( const rfca_t* r ) {
+    bitboard_t* bb = bitboard_create( r->buffer );
+    bitboard_copyFrom( bb, r );
+    return bb;
+}
+
+/*
+ * Overwrite bb with the nodes of the base-2 automaton r, which must have the same shape
+ */
+void
+bitboard_copyFrom( bitboard_t* bb, const rfca_t* r ) {
+    bitboard_clear( bb );
+    for( int i =0; i < bb->rowCount; i++ ) {
+        const int size = bb->rowSize[i];
+        const rfca_node_t* cols = r->buffer->rows[i].cols;
+        uint64_t* row = bb->rows[i];
+        for( int j =0; j < size; j++ ) {
+            // Left-folding automata are stored mirrored, see transpose()
+            rfca_node_t value = r->opts.right ? cols[j] : cols[(size-1) - j];
+            if( value & 1 )
+                row[j >> 6] |= 1ULL << (j & 63);
+        }
+    }
+}
+
+void
+bitboard_free( bitboard_t* bb ) {
+    free( bb->data );
+    free( bb->rows );
+    free( bb->rowSize );
+    free( bb );
+}
+
+/*
+ * Write the values in bb to all nodes of r, which must have the same shape
+ */
+void
+bitboard_copyTo( const bitboard_t* bb, rfca_t* r ) {
+    for( int i =0; i < bb->rowCount; i++ ) {
+        const int size = bb->rowSize[i];
+        rfca_node_t* cols = r->buffer->rows[i].cols;
+        const uint64_t* row = bb->rows[i];
+        for( int j =0; j < size; j++ ) {
+            rfca_node_t value = (row[j >> 6] >> (j & 63)) & 1;
+            cols[r->opts.right ? j : (size-1) - j] = value;
+        }
+    }
+}
+
+/*
+ * Group the offsets of p by row, in chunks of at most 64 consecutive columns
+ */
+void
+bitboard_pattern_init( bitboard_pattern_t* bp, const pattern_t* p ) {
+    bitboard_pattern_initWith( bp, p, (bitboard_rowmask_t*)malloc( sizeof( bitboard_rowmask_t ) * p->size ) );
+}
+
+/*
+ * Same as bitboard_pattern_init(), using caller-owned storage for at least p->size row masks.
+ * A pattern initialized this way must not be passed to bitboard_pattern_destroy().
+ */
+void
+bitboard_pattern_initWith( bitboard_pattern_t* bp, const pattern_t* p, bitboard_rowmask_t* rows ) {
+    bp->rows = rows;
+    bp->count =0;
+    bp->first = p->offsets[0];
+
+    for( unsigned int k =0; k < p->size; k++ ) {
+        const pattern_offset_t* o = &p->offsets[k];
+        bitboard_rowmask_t* rm = NULL;
+        for( int g =0; g < bp->count; g++ ) {
+            if( bp->rows[g].row == o->row && o->col >= bp->rows[g].col && o->col < bp->rows[g].col + 64 ) {
+                rm = &bp->rows[g];
+                break;
+            }
+        }
+        if( !rm ) {
+            // Canonical patterns are sorted by column, so a new chunk starts at this offset
+            rm = &bp->rows[bp->count++];
+            rm->row = o->row;
+            rm->col = o->col;
+            rm->care =0;
+            rm->value =0;
+        }
+        const int b = o->col - rm->col;
+        rm->care |= 1ULL << b;
+        if( o->value & 1 )
+            rm->value |= 1ULL << b;
+    }
+}
+
+void
+bitboard_pattern_destroy( bitboard_pattern_t* bp ) {
+    free( bp->rows );
+}
+
+/*
+ * Test bp against the pivots {row,col} .. {row,col+count-1} at once.
+ * For base 2 a match means every node equals the pattern, or every node equals its complement.
+ * Returns a bit mask with bit l set if bp matches nodes of bb at {row,col+l} that are not set in mask,
+ * the variant of each lane is written to the corresponding bit in variants.
+ * All pivots must lie within pattern_rowBounds() and count <= BITBOARD_LANES.
+ */
+uint64_t
+bitboard_matchRow( const bitboard_pattern_t* bp, const bitboard_t* bb, const bitboard_t* mask, int row, int col, int count, uint64_t* variants ) {
+    const pattern_offset_t* f = &bp->first;
+    uint64_t v = extract( bb->rows[row + f->row], col + f->col );
+    if( f->value & 1 )
+        v = ~v;
+    uint64_t acc = lanemask( count );
+
+    for( int g =0; g < bp->count && acc; g++ ) {
+        const bitboard_rowmask_t* rm = &bp->rows[g];
+        const uint64_t* values = bb->rows[row + rm->row];
+        const uint64_t* masked = mask->rows[row + rm->row];
+        uint64_t care = rm->care;
+        while( care ) {
+            const int b = __builtin_ctzll( care );
+            care &= care - 1;
+            const int c = col + rm->col + b;
+            const uint64_t expect = ((rm->value >> b) & 1) ? ~v : v;
+            acc &= ~(extract( values, c ) ^ expect) & ~extract( masked, c );
+        }
+    }
+    *variants = v;
+    return acc;
+}
+
+/*
+ * Returns true if none of the nodes covered by bp at pivot are masked
+ */
+bool
+bitboard_isFree( const bitboard_pattern_t* bp, const bitboard_t* mask, rfca_coord_t pivot ) {
+    for( int g =0; g < bp->count; g++ ) {
+        const bitboard_rowmask_t* rm = &bp->rows[g];
+        if( extract( mask->rows[pivot.row + rm->row], pivot.col + rm->col ) & rm->care )
+            return false;
+    }
+    return true;
+}
+
+void
+bitboard_setMasked( const bitboard_pattern_t* bp, bitboard_t* mask, rfca_coord_t pivot ) {
+    for( int g =0; g < bp->count; g++ ) {
+        const bitboard_rowmask_t* rm = &bp->rows[g];
+        deposit( mask->rows[pivot.row + rm->row], pivot.col + rm->col, rm->care );
+    }
+}
+
+/*
+ * Write the nodes of a region to bb, whose nodes at these positions must still be zero
+ */
+void
+bitboard_apply( const bitboard_pattern_t* bp, bitboard_t* bb, rfca_coord_t pivot, int variant ) {
+    for( int g =0; g < bp->count; g++ ) {
+        const bitboard_rowmask_t* rm = &bp->rows[g];
+        const uint64_t bits = (variant & 1) ? ~rm->value & rm->care : rm->value;
+        deposit( bb->rows[pivot.row + rm->row], pivot.col + rm->col, bits );
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+// Bit-per-node representation of base-2 automata, used for matching and decoding
+
+#include "rfca.h"
+#include "pattern.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BITBOARD_LANES 64
+
+/* One bit per node in logical coordinates, bit j%64 of word j/64 holds column j.
+ * The same structure holds node values or a mask of nodes covered by regions.
+ * Each row is followed by one zero word so that any 64 bits starting inside a row can be read.
+ */
+typedef struct {
+    uint64_t** rows;
+    int* rowSize;
+    int rowCount;
+    int nodeCount;
+    int words;
+    uint64_t* data;
+} bitboard_t;
+
+/* The offsets of a pattern that lie on the same row and within 64 columns of each other */
+typedef struct {
+    int row;
+    int col;        // column of bit 0, relative to the pivot
+    uint64_t care;  // bit b is set if the pattern has an offset at {row,col+b}
+    uint64_t value; // the value of each of those offsets
+} bitboard_rowmask_t;
+
+/* A pattern represented as per-row bit masks */
+typedef struct {
+    bitboard_rowmask_t* rows;
+    int count;
+    pattern_offset_t first; // offset that determines the variant
+} bitboard_pattern_t;
+
+bitboard_t*
+bitboard_create( const rfca_buffer_t* shape );
+
+bitboard_t*
+bitboard_createFrom( const rfca_t* r );
+
+void
+bitboard_copyFrom( bitboard_t* bb, const rfca_t* r );
+
+bitboard_t*
+bitboard_createLike( const bitboard_t* bb );
+
+void
+bitboard_clear( bitboard_t* bb );
+
+void
+bitboard_free( bitboard_t* bb );
+
+void
+bitboard_copyTo( const bitboard_t* bb, rfca_t* r );
+
+void
+bitboard_pattern_init( bitboard_pattern_t* bp, const pattern_t* p );
+
+void
+bitboard_pattern_initWith( bitboard_pattern_t* bp, const pattern_t* p, bitboard_rowmask_t* rows );
+
+void
+bitboard_pattern_destroy( bitboard_pattern_t* bp );
+
+uint64_t
+bitboard_matchRow( const bitboard_pattern_t* bp, const bitboard_t* bb, const bitboard_t* mask, int row, int col, int count, uint64_t* variants );
+
+bool
+bitboard_isFree( const bitboard_pattern_t* bp, const bitboard_t* mask, rfca_coord_t pivot );
+
+void
+bitboard_setMasked( const bitboard_pattern_t* bp, bitboard_t* mask, rfca_coord_t pivot );
+
+void
+bitboard_apply( const bitboard_pattern_t* bp, bitboard_t* bb, rfca_coord_t pivot, int variant );
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // flockfile(), strdup()
+
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define CACHE_HEADER "vouw cache 1"
+#define CACHE_LINE_MAX (2 * CACHE_KEY_MAX + 256)
+
+static uint64_t
+cache_hash( const char* key ) {
+    uint64_t h = 14695981039346656037ULL;
+    for( ; *key; key++ )
+        h = (h ^ (unsigned char)*key) * 1099511628211ULL;
+    return h;
+}
+
+/*
+ * Describe the automaton generated by opts as `mode.base.rule/input/folds/right'
+ */
+static int
+cache_key( char* buf, size_t size, const rfca_opts_t* opts ) {
+    int n = snprintf( buf, size, "%d.%d.%"PRIu64"/", opts->mode, opts->base, opts->rule );
+    for( int i =0; i < opts->inputSize && n < (int)size; i++ )
+        n += snprintf( buf + n, size - n, "%d", (int)opts->input[i] );
+    if( n < (int)size )
+        n += snprintf( buf + n, size - n, "/%d/%d", opts->folds, opts->right ? 1 : 0 );
+    return n;
+}
+
+static void
+cache_selfKey( char* buf, size_t size, const rfca_opts_t* opts ) {
+    int n = snprintf( buf, size, "self " );
+    cache_key( buf + n, size - n, opts );
+}
+
+static void
+cache_crossKey( char* buf, size_t size, const rfca_opts_t* codeTable, const rfca_opts_t* target ) {
+    int n = snprintf( buf, size, "cross " );
+    n += cache_key( buf + n, size - n, codeTable );
+    if( n < (int)size ) {
+        n += snprintf( buf + n, size - n, " " );
+        cache_key( buf + n, size - n, target );
+    }
+}
+
+static cache_entry_t*
+cache_lookup( const cache_t* c, const char* key, uint64_t hash ) {
+    cache_entry_t* e = c->buckets[hash & (c->capacity-1)];
+    for( ; e; e = e->next ) {
+        if( e->hash == hash && strcmp( e->key, key ) == 0 )
+            break;
+    }
+    return e;
+}
+
+static void
+cache_grow( cache_t* c ) {
+    uint64_t capacity = c->capacity * 2;
+    cache_entry_t** buckets = (cache_entry_t**)calloc( capacity, sizeof( cache_entry_t* ) );
+    for( uint64_t i =0; i < c->capacity; i++ ) {
+        cache_entry_t* e = c->buckets[i];
+        while( e ) {
+            cache_entry_t* next = e->next;
+            e->next = buckets[e->hash & (capacity-1)];
+            buckets[e->hash & (capacity-1)] = e;
+            e = next;
+        }
+    }
+    free( c->buckets );
+    c->buckets = buckets;
+    c->capacity = capacity;
+}
+
+/*
+ * Add or replace the result for key in the index, the caller holds the lock
+ */
+static void
+cache_insert( cache_t* c, const char* key, const cache_self_t* result ) {
+    const uint64_t hash = cache_hash( key );
+    cache_entry_t* e = cache_lookup( c, key, hash );
+    if( !e ) {
+        if( c->count >= c->capacity )
+            cache_grow( c );
+        e = (cache_entry_t*)malloc( sizeof( cache_entry_t ) );
+        e->hash = hash;
+        e->key = strdup( key );
+        e->next = c->buckets[hash & (c->capacity-1)];
+        c->buckets[hash & (c->capacity-1)] = e;
+        c->count++;
+    }
+    e->self = *result;
+}
+
+/*
+ * Parse one line of a cache file into the index, returns false if it is not a result
+ */
+static bool
+cache_parseLine( cache_t* c, const char* line ) {
+    char key[CACHE_LINE_MAX];
+    char k1[CACHE_KEY_MAX], k2[CACHE_KEY_MAX];
+    cache_self_t result;
+    memset( &result, 0, sizeof( result ) );
+
+    if( strncmp( line, "self ", 5 ) == 0 ) {
+        if( sscanf( line + 5, "%1199s %la %la %d %"SCNx64, k1, &result.uncompressed, &result.compressed,
+                    &result.steps, &result.digest ) != 5 )
+            return false;
+        snprintf( key, sizeof( key ), "self %s", k1 );
+    } else if( strncmp( line, "cross ", 6 ) == 0 ) {
+        if( sscanf( line + 6, "%1199s %1199s %la", k1, k2, &result.compressed ) != 3 )
+            return false;
+        snprintf( key, sizeof( key ), "cross %s %s", k1, k2 );
+    } else
+        return false;
+    cache_insert( c, key, &result );
+    return true;
+}
+
+/*
+ * Open or create a cache file and read all results in it.
+ * Returns NULL and prints an error message if the file cannot be used.
+ */
+cache_t*
+cache_open( const char* path ) {
+    cache_t* c = (cache_t*)malloc( sizeof( cache_t ) );
+    c->file =NULL;
+    c->capacity =1024;
+    c->buckets = (cache_entry_t**)calloc( c->capacity, sizeof( cache_entry_t* ) );
+    c->count =0;
+    c->hits =c->misses =0;
+    pthread_mutex_init( &c->lock, NULL );
+
+    bool newline =true, empty =true;
+    FILE* f = fopen( path, "r" );
+    if( f ) {
+        char line[CACHE_LINE_MAX];
+        if( fgets( line, sizeof( line ), f ) ) {
+            empty =false;
+            line[strcspn( line, "\n" )] ='\0';
+            if( strcmp( line, CACHE_HEADER ) != 0 ) {
+                fprintf( stderr, "Error: `%s' is not a cache file\n", path );
+                fclose( f );
+                cache_close( c );
+                return NULL;
+            }
+        }
+        while( fgets( line, sizeof( line ), f ) ) {
+            // A line that was only partially written when a run was killed is ignored
+            newline = strchr( line, '\n' ) != NULL;
+            if( newline )
+                cache_parseLine( c, line );
+        }
+        fclose( f );
+    }
+
+    c->file = fopen( path, "a" );
+    if( !c->file ) {
+        fprintf( stderr, "Error: Cannot open cache file `%s'\n", path );
+        cache_close( c );
+        return NULL;
+    }
+    if( empty )
+        fprintf( c->file, "%s\n", CACHE_HEADER );
+    else if( !newline )
+        fputc( '\n', c->file );
+    fflush( c->file );
+    return c;
+}
+
+void
+cache_close( cache_t* c ) {
+    if( c->file )
+        fclose( c->file );
+    for( uint64_t i =0; i < c->capacity; i++ ) {
+        cache_entry_t* e = c->buckets[i];
+        while( e ) {
+            cache_entry_t* next = e->next;
+            free( e->key );
+            free( e );
+            e = next;
+        }
+    }
+    pthread_mutex_destroy( &c->lock );
+    free( c->buckets );
+    free( c );
+}
+
+static bool
+cache_find( cache_t* c, const char* key, cache_self_t* result ) {
+    const uint64_t hash = cache_hash( key );
+    pthread_mutex_lock( &c->lock );
+    const cache_entry_t* e = cache_lookup( c, key, hash );
+    if( e ) {
+        *result = e->self;
+        c->hits++;
+    } else
+        c->misses++;
+    pthread_mutex_unlock( &c->lock );
+    return e != NULL;
+}
+
+/*
+ * Look up the self-encoding of the automaton generated by opts. May be called from multiple threads.
+ */
+bool
+cache_findSelf( cache_t* c, const rfca_opts_t* opts, cache_self_t* result ) {
+    char key[CACHE_LINE_MAX];
+    cache_selfKey( key, sizeof( key ), opts );
+    return cache_find( c, key, result );
+}
+
+/*
+ * Store the self-encoding of the automaton generated by opts and append it to the file.
+ * May be called from multiple threads.
+ */
+void
+cache_storeSelf( cache_t* c, const rfca_opts_t* opts, const cache_self_t* result ) {
+    char key[CACHE_LINE_MAX];
+    cache_selfKey( key, sizeof( key ), opts );
+    pthread_mutex_lock( &c->lock );
+    cache_insert( c, key, result );
+    pthread_mutex_unlock( &c->lock );
+
+    flockfile( c->file );
+    fprintf( c->file, "%s %a %a %d %016"PRIx64"\n", key, result->uncompressed, result->compressed,
+        result->steps, result->digest );
+    fflush( c->file );
+    funlockfile( c->file );
+}
+
+/*
+ * Look up the length of the automaton generated by target, encoded with the code table
+ * of the automaton generated by codeTable. May be called from multiple threads.
+ */
+bool
+cache_findCross( cache_t* c, const rfca_opts_t* codeTable, const rfca_opts_t* target, double* compressed ) {
+    char key[CACHE_LINE_MAX];
+    cache_self_t result;
+    cache_crossKey( key, sizeof( key ), codeTable, target );
+    if( !cache_find( c, key, &result ) )
+        return false;
+    *compressed = result.compressed;
+    return true;
+}
+
+/*
+ * Store a cross-encoded length as found by cache_findCross() and append it to the file.
+ * May be called from multiple threads.
+ */
+void
+cache_storeCross( cache_t* c, const rfca_opts_t* codeTable, const rfca_opts_t* target, double compressed ) {
+    char key[CACHE_LINE_MAX];
+    cache_self_t result;
+    memset( &result, 0, sizeof( result ) );
+    result.compressed = compressed;
+    cache_crossKey( key, sizeof( key ), codeTable, target );
+    pthread_mutex_lock( &c->lock );
+    cache_insert( c, key, &result );
+    pthread_mutex_unlock( &c->lock );
+
+    flockfile( c->file );
+    fprintf( c->file, "%s %a\n", key, compressed );
+    fflush( c->file );
+    funlockfile( c->file );
+}
+
+void
+cache_printStats( const cache_t* c, FILE* f ) {
+    fprintf( f, "Result cache: %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" results stored\n",
+        c->hits, c->misses, c->count );
+}
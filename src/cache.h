@@ -0,0 +1,75 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+// Persistent store of encoding results, so that configurations are encoded only once across runs
+
+#include "rfca.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Long enough for the description of two automata with the longest input
+#define CACHE_KEY_MAX 1200
+
+/* Result of encoding an automaton with its own code table */
+typedef struct {
+    double uncompressed;    // ctBits + encodedBits before the first step
+    double compressed;      // ctBits + encodedBits after the last step
+    int steps;
+    uint64_t digest;        // see pattern_list_digest()
+} cache_self_t;
+
+typedef struct cache_entry {
+    struct cache_entry* next;
+    uint64_t hash;
+    char* key;
+    cache_self_t self;      // for cross-encodings only compressed is used
+} cache_entry_t;
+
+/* The file starts with the line CACHE_HEADER, every other line holds one result as either
+ *   self KEY uncompressed compressed steps digest
+ *   cross KEY1 KEY2 compressed
+ * where KEY describes an automaton as `mode.base.rule/input/folds/right' and a cross result is
+ * the length of automaton KEY2 encoded with the code table of KEY1. Lengths are written in
+ * hexadecimal floating point (%a) so that they are read back exactly.
+ * Results are only ever appended, a later line for the same key replaces an earlier one.
+ */
+typedef struct {
+    FILE* file;
+    cache_entry_t** buckets;
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t hits, misses;
+    pthread_mutex_t lock;
+} cache_t;
+
+cache_t*
+cache_open( const char* path );
+
+void
+cache_close( cache_t* c );
+
+bool
+cache_findSelf( cache_t* c, const rfca_opts_t* opts, cache_self_t* result );
+
+void
+cache_storeSelf( cache_t* c, const rfca_opts_t* opts, const cache_self_t* result );
+
+bool
+cache_findCross( cache_t* c, const rfca_opts_t* codeTable, const rfca_opts_t* target, double* compressed );
+
+void
+cache_storeCross( cache_t* c, const rfca_opts_t* codeTable, const rfca_opts_t* target, double compressed );
+
+void
+cache_printStats( const cache_t* c, FILE* f );
+
+#endif
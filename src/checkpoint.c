@@ -0,0 +1,183 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // flockfile()
+
+#include "checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+typedef struct {
+    uint64_t rule;
+    double value;
+} checkpoint_entry_t;
+
+static int
+checkpoint_cmp( const void* a, const void* b ) {
+    const checkpoint_entry_t* ea = (const checkpoint_entry_t*)a;
+    const checkpoint_entry_t* eb = (const checkpoint_entry_t*)b;
+    return ea->rule < eb->rule ? -1 : ea->rule > eb->rule;
+}
+
+/*
+ * Read the header and all complete result lines from f.
+ * A line that was only partially written when a run was killed is ignored.
+ * Returns false if the file does not start with a header.
+ * If trailingNewline is given, it is set to whether f ends with a newline.
+ */
+static bool
+checkpoint_load( checkpoint_t* cp, FILE* f, bool* trailingNewline ) {
+    char line[CHECKPOINT_HEADER_MAX];
+    uint64_t capacity =0;
+    checkpoint_entry_t* entries = NULL;
+    bool newline =true;
+
+    cp->count =0;
+    cp->header[0] ='\0';
+    if( !fgets( cp->header, sizeof( cp->header ), f ) )
+        return false;
+    newline = strchr( cp->header, '\n' ) != NULL;
+    cp->header[strcspn( cp->header, "\n" )] ='\0';
+
+    while( fgets( line, sizeof( line ), f ) ) {
+        uint64_t rule;
+        double value;
+        newline = strchr( line, '\n' ) != NULL;
+        if( !newline || sscanf( line, "%"SCNu64" %la", &rule, &value ) != 2 )
+            continue;
+        if( cp->count == capacity ) {
+            capacity = capacity ? capacity * 2 : 1024;
+            entries = (checkpoint_entry_t*)realloc( entries, sizeof( checkpoint_entry_t ) * capacity );
+        }
+        entries[cp->count].rule =rule;
+        entries[cp->count].value =value;
+        cp->count++;
+    }
+    if( trailingNewline )
+        *trailingNewline =newline;
+
+    // Results are appended in order of completion
+    qsort( entries, cp->count, sizeof( checkpoint_entry_t ), checkpoint_cmp );
+    cp->rules = (uint64_t*)malloc( sizeof( uint64_t ) * (cp->count + 1) );
+    cp->values = (double*)malloc( sizeof( double ) * (cp->count + 1) );
+    for( uint64_t i =0; i < cp->count; i++ ) {
+        cp->rules[i] = entries[i].rule;
+        cp->values[i] = entries[i].value;
+    }
+    free( entries );
+    return true;
+}
+
+static checkpoint_t*
+checkpoint_alloc( void ) {
+    checkpoint_t* cp = (checkpoint_t*)malloc( sizeof( checkpoint_t ) );
+    cp->file =NULL;
+    cp->header[0] ='\0';
+    cp->rules =NULL;
+    cp->values =NULL;
+    cp->count =0;
+    return cp;
+}
+
+/*
+ * Open a checkpoint file for appending. If the file already holds results, its header must equal
+ * the given header and the results can be looked up with checkpoint_find().
+ * Returns NULL and prints an error message if the file cannot be used.
+ */
+checkpoint_t*
+checkpoint_open( const char* path, const char* header ) {
+    checkpoint_t* cp = checkpoint_alloc();
+    bool newline =true;
+
+    FILE* f = fopen( path, "r" );
+    if( f ) {
+        if( checkpoint_load( cp, f, &newline ) && strcmp( cp->header, header ) != 0 ) {
+            fprintf( stderr, "Error: Checkpoint file `%s' was written by a different run:\n%s\n", path, cp->header );
+            fclose( f );
+            checkpoint_close( cp );
+            return NULL;
+        }
+        fclose( f );
+    }
+
+    cp->file = fopen( path, "a" );
+    if( !cp->file ) {
+        fprintf( stderr, "Error: Cannot open checkpoint file `%s'\n", path );
+        checkpoint_close( cp );
+        return NULL;
+    }
+    if( cp->header[0] == '\0' ) {
+        strncpy( cp->header, header, sizeof( cp->header ) -1 );
+        cp->header[sizeof( cp->header ) -1] ='\0';
+        fprintf( cp->file, "%s\n", header );
+    } else if( !newline )
+        // Terminate a line that was cut off, it has been ignored above
+        fputc( '\n', cp->file );
+    fflush( cp->file );
+    return cp;
+}
+
+/*
+ * Read all results from a checkpoint file, returns NULL if it cannot be read
+ */
+checkpoint_t*
+checkpoint_read( const char* path ) {
+    FILE* f = fopen( path, "r" );
+    if( !f ) {
+        fprintf( stderr, "Error: Cannot open checkpoint file `%s'\n", path );
+        return NULL;
+    }
+    checkpoint_t* cp = checkpoint_alloc();
+    bool ok = checkpoint_load( cp, f, NULL );
+    fclose( f );
+    if( !ok ) {
+        fprintf( stderr, "Error: `%s' is not a checkpoint file\n", path );
+        checkpoint_close( cp );
+        return NULL;
+    }
+    return cp;
+}
+
+/*
+ * Look up the result for rule among the results that were read from the file
+ */
+bool
+checkpoint_find( const checkpoint_t* cp, uint64_t rule, double* value ) {
+    uint64_t lo =0, hi = cp->count;
+    while( lo < hi ) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if( cp->rules[mid] < rule )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if( lo == cp->count || cp->rules[lo] != rule )
+        return false;
+    *value = cp->values[lo];
+    return true;
+}
+
+/*
+ * Append a result and flush it to the file. May be called from multiple threads.
+ */
+void
+checkpoint_append( checkpoint_t* cp, uint64_t rule, double value ) {
+    flockfile( cp->file );
+    fprintf( cp->file, "%"PRIu64" %a\n", rule, value );
+    fflush( cp->file );
+    funlockfile( cp->file );
+}
+
+void
+checkpoint_close( checkpoint_t* cp ) {
+    if( cp->file )
+        fclose( cp->file );
+    free( cp->rules );
+    free( cp->values );
+    free( cp );
+}
@@ -0,0 +1,46 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// Append-only files with per-rule results of a batch run, so that it can be resumed or merged
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CHECKPOINT_HEADER_MAX 2048
+
+/* The first line of a checkpoint file describes the run, every other line holds
+ * one result as `rule value', with the value in hexadecimal floating point (%a)
+ * so that it is read back exactly.
+ */
+typedef struct {
+    FILE* file;         // NULL if opened with checkpoint_read()
+    char header[CHECKPOINT_HEADER_MAX];
+    uint64_t* rules;    // results read from the file, sorted by rule
+    double* values;
+    uint64_t count;
+} checkpoint_t;
+
+checkpoint_t*
+checkpoint_open( const char* path, const char* header );
+
+checkpoint_t*
+checkpoint_read( const char* path );
+
+bool
+checkpoint_find( const checkpoint_t* cp, uint64_t rule, double* value );
+
+void
+checkpoint_append( checkpoint_t* cp, uint64_t rule, double value );
+
+void
+checkpoint_close( checkpoint_t* cp );
+
+#endif
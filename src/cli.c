@@ -7,6 +7,7 @@
 
 #include "cli.h"
 #include "module.h"
+#include "dataset.h"
 #include <stdio.h>
 #include <stdbool.h>
 #include <inttypes.h>
@@ -21,7 +22,7 @@
 void 
 cli_printHelp( char* exec ) {
     fprintf( stderr, "VOUW - Generation, encoding and pattern-mining of Reduce-Fold Cellular Automata\n\
-usage: %s MODULE [-r rule] [-b base][-m mode] [-i input] [--right] [-o output] [-f folds]\n\
+usage: %s MODULE [-r rule] [-b base][-m mode] [-i input] [--right] [-o output] [-f folds] [--from-file FILE]\n\
 \n\
 \t MODULE        \t Specify a module to operate on the automaton (see below). \n\
 \t -r \n\
@@ -35,6 +36,8 @@ usage: %s MODULE [-r rule] [-b base][-m mode] [-i input] [--right] [-o output] [
 \t -f \n\
 \t --folds       \t Number of folds after reducing all input nodes.\n\
 \t --right       \t Create a right-folding automaton, the default is left-folding.\n\
+\t --from-file   \t Read the automaton from a file written by the `generate' module instead of generating it,\n\
+\t               \t which gives all other options.\n\
 ", exec );
     fprintf( stderr, "The following module-names are supported:\n" );
     module_printList( stderr );
@@ -44,32 +47,56 @@ bool
 cli_parseOpts( rfca_opts_t* opts, char** argv_ptr[0], int* argc ) {
 
     const char* param_input = NULL;
+    const char* param_file = NULL;
+    const char* param_shape = NULL; // last option that sets what is also read from a file
     char **argv =*argv_ptr;
 
     // Parse the basic arguments from the commandline
     int i =0;
     for( i = 0; i < *argc; i++ ) {
         if( strncmp( argv[i], "-m", 2 ) == 0 || strncmp( argv[i], "--mode", 6 ) == 0 ) {
+            param_shape =argv[i];
             opts->mode =atoi( argv[++i] );
         } else if( strncmp( argv[i], "-r", 2 ) == 0 || strncmp( argv[i], "--rule", 6 ) == 0 ) {
+            param_shape =argv[i];
             // We use strtoull() here for 64 bit unsigned integers
             // TODO: use _strtoui64() on Windows;
             opts->rule =strtoull( argv[++i], NULL, 0 );
         } else if( strncmp( argv[i], "-b", 2 ) == 0 || strncmp( argv[i], "--base", 6 ) == 0 ) {
+            param_shape =argv[i];
             opts->base =atoi( argv[++i] );
         } else if( strncmp( argv[i], "-f", 2 ) == 0 || strncmp( argv[i], "--folds", 7 ) == 0 ) {
+            param_shape =argv[i];
             opts->folds =atoi( argv[++i] );
         } else if( strncmp( argv[i], "-i", 2 ) == 0 || strncmp( argv[i], "--input", 7 ) == 0 ) {
+            param_shape =argv[i];
             param_input =argv[++i];
         /*} else if( strncmp( argv[i], "-o", 2 ) == 0 || strncmp( argv[i], "--output", 8 ) == 0 ) {
             param_outfile =argv[++i];*/
         } else if( strncmp( argv[i], "--right", 7 ) == 0 ) {
+            param_shape =argv[i];
             opts->right =true;
+        } else if( strcmp( argv[i], "--from-file" ) == 0 && i+1 < *argc ) {
+            if( param_file ) {
+                fprintf( stderr, "Error: Parameter `from-file' can only be given once\n" );
+                return false;
+            }
+            param_file =argv[++i];
         } else {
             break;
         }
     }
 
+    // Take all options from the file, the nodes are read from it by rfca_generate()
+    if( param_file ) {
+        if( param_shape ) {
+            fprintf( stderr, "Error: Parameter `%s' cannot be combined with `from-file', which gives the automaton\n", param_shape );
+            return false;
+        }
+        if( !dataset_readOpts( param_file, opts ) )
+            return false;
+    }
+
     // Prepare the parameters to the rfca and check the valid ranges
     if( opts->folds > FOLDS_MAX ) {
         fprintf( stderr, "Error: Parameter `folds' larger than allowed maximum (%d)\n", FOLDS_MAX );
@@ -113,3 +140,30 @@ cli_parseOpts( rfca_opts_t* opts, char** argv_ptr[0], int* argc ) {
 
     return true;
 }
+
+/*
+ * Describe the automaton of opts in buf, as in the headers of the files that keep results of rules.
+ * Returns the length of the description, as snprintf().
+ */
+int
+cli_formatOpts( char* buf, size_t size, const rfca_opts_t* opts ) {
+    int n = snprintf( buf, size, "%d.%d.%"PRIu64" input ", opts->mode, opts->base, opts->rule );
+    for( int i =0; i < opts->inputSize && n < (int)size; i++ )
+        n += snprintf( buf + n, size - n, "%d", (int)opts->input[i] );
+    if( n < (int)size )
+        n += snprintf( buf + n, size - n, " folds %d right %d", opts->folds, opts->right ? 1 : 0 );
+    return n;
+}
+
+/*
+ * Returns false and prints an error message if the automaton of opts is read from a file.
+ * Results of rules are kept in checkpoints and caches by their options, which do not tell
+ * an automaton from a file apart from the generated one.
+ */
+bool
+cli_checkGenerated( const rfca_opts_t* opts ) {
+    if( !opts->file )
+        return true;
+    fprintf( stderr, "Error: --from-file cannot be used with the rulespace modules, they generate every automaton\n" );
+    return false;
+}
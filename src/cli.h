@@ -9,6 +9,7 @@
 #define CLI_H
 
 #include "rfca.h"
+#include <stddef.h>
 
 // Some boundaries and defaults
 #define BASE_DEFAULT 2
@@ -25,5 +26,11 @@ cli_printHelp( char* exec );
 bool
 cli_parseOpts( rfca_opts_t *opts, char** argv[0], int* argc );
 
+int
+cli_formatOpts( char* buf, size_t size, const rfca_opts_t* opts );
+
+bool
+cli_checkGenerated( const rfca_opts_t* opts );
+
 #endif
 
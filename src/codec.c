@@ -0,0 +1,297 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "codec.h"
+#include "range.h"
+#include "cli.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEC_MAGIC "VOUWENC"
+#define CODEC_VERSION 1
+// Upper bound on the number of patterns in a code table
+#define CODEC_PATTERNS_MAX (1ull << 32)
+
+/*
+ * Compute the cumulative frequencies of the patterns of the regions from their usages, such that they add up
+ * to at most RANGE_TOTAL_MAX and every used pattern keeps a frequency of at least one.
+ * Returns the total, or 0 if there are too many patterns and they are coded uniformly.
+ */
+static uint32_t
+codec_model( const unsigned int* usage, int n, uint32_t* cum ) {
+    uint64_t total =0;
+    int used =0;
+    for( int k =0; k < n; k++ ) {
+        total += usage[k];
+        used += usage[k] != 0;
+    }
+    if( used > (int)(RANGE_TOTAL_MAX / 2) )
+        return 0;
+
+    const uint64_t target = RANGE_TOTAL_MAX - used;
+    cum[0] =0;
+    for( int k =0; k < n; k++ ) {
+        uint64_t freq = usage[k];
+        if( total > RANGE_TOTAL_MAX && freq ) {
+            freq = freq * target / total;
+            if( freq == 0 )
+                freq =1;
+        }
+        cum[k+1] = cum[k] + (uint32_t)freq;
+    }
+    return cum[n];
+}
+
+/*
+ * Returns the index of each row's first node among all nodes, in row order
+ */
+static uint64_t*
+codec_rowStarts( const rfca_buffer_t* b ) {
+    uint64_t* start = (uint64_t*)malloc( sizeof( uint64_t ) * (b->rowCount + 1) );
+    start[0] =0;
+    for( int i =0; i < b->rowCount; i++ )
+        start[i+1] = start[i] + b->rows[i].size;
+    return start;
+}
+
+/*
+ * Write the encoding of v to f and return the number of bytes written.
+ * The patterns of the code table are numbered in list order.
+ */
+uint64_t
+codec_write( vouw_t* v, FILE* f ) {
+    const rfca_opts_t* opts = &v->rfca->opts;
+    const rfca_buffer_t* b = v->rfca->buffer;
+    const uint64_t nodes = b->nodeCount;
+
+    codec_header_t h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.magic, CODEC_MAGIC, sizeof( CODEC_MAGIC ) );
+    h.version =CODEC_VERSION;
+    h.mode =opts->mode;
+    h.base =opts->base;
+    h.folds =opts->folds;
+    h.right =opts->right;
+    h.inputSize =opts->inputSize;
+    h.rule =opts->rule;
+    fwrite( &h, sizeof( h ), 1, f );
+    for( int i =0; i < opts->inputSize; i++ )
+        putc( (uint8_t)opts->input[i], f );
+
+    range_encoder_t e;
+    range_encoder_init( &e, f );
+
+    const int n = pattern_list_setIndices( v->codeTable );
+    unsigned int* usage = (unsigned int*)malloc( sizeof( unsigned int ) * (n + 1) );
+    range_encodeUniform( &e, n, CODEC_PATTERNS_MAX );
+    struct list_head* pos;
+    list_for_each( pos, &(v->codeTable->list) ) {
+        const pattern_t* p = list_entry( pos, pattern_t, list );
+        usage[p->index] = p->usage;
+        range_encodeUniform( &e, p->usage, nodes + 1 );
+        range_encodeUniform( &e, p->size - 1, nodes );
+        for( unsigned int i =0; i < p->size; i++ ) {
+            range_encodeUniform( &e, p->offsets[i].row + (b->rowCount - 1), 2 * b->rowCount - 1 );
+            range_encodeUniform( &e, p->offsets[i].col + (b->width - 1), 2 * b->width - 1 );
+            range_encodeUniform( &e, p->offsets[i].value, opts->base );
+        }
+    }
+
+    uint32_t* cum = (uint32_t*)malloc( sizeof( uint32_t ) * (n + 1) );
+    const uint32_t total = codec_model( usage, n, cum );
+    uint64_t* start = codec_rowStarts( b );
+    list_for_each( pos, &(v->encoded->list) ) {
+        const region_t* region = list_entry( pos, region_t, list );
+        const int k = region->pattern->index;
+        if( total )
+            range_encode( &e, cum[k], cum[k+1] - cum[k], total );
+        else
+            range_encodeUniform( &e, k, n );
+        range_encodeUniform( &e, start[region->pivot.row] + region->pivot.col, nodes );
+        range_encodeUniform( &e, region->variant, opts->base );
+    }
+    range_encoder_finish( &e );
+
+    free( start );
+    free( cum );
+    free( usage );
+    return sizeof( h ) + opts->inputSize + e.bytes;
+}
+
+/*
+ * Read an encoded automaton from f. If encoded is NULL, it is decoded as its regions are read.
+ * Otherwise only the shape of the automaton is created (see rfca_createShape()) and
+ * the code table and the regions are returned in codeTable and encoded instead.
+ * Returns NULL and prints an error message if f does not hold a valid encoding.
+ */
+static rfca_t*
+codec_readFile( FILE* f, uint64_t* bytes, pattern_t** codeTable, region_t** encoded ) {
+    codec_header_t h;
+    if( fread( &h, sizeof( h ), 1, f ) != 1 || memcmp( h.magic, CODEC_MAGIC, sizeof( CODEC_MAGIC ) ) != 0 ||
+        h.version != CODEC_VERSION ) {
+        fprintf( stderr, "Error: Not an encoded automaton\n" );
+        return NULL;
+    }
+    rfca_opts_t opts;
+    opts.mode =h.mode;
+    opts.base =h.base;
+    opts.folds =h.folds;
+    opts.right =h.right != 0;
+    opts.inputSize =h.inputSize;
+    opts.rule =h.rule;
+    opts.file =NULL;
+    if( opts.mode < 2 || opts.mode > MODE_MAX || opts.base < 2 || opts.base > BASE_MAX ||
+        opts.inputSize < 1 || opts.inputSize > INPUT_MAX || opts.folds < 0 || opts.folds > FOLDS_MAX ) {
+        fprintf( stderr, "Error: Not an encoded automaton\n" );
+        return NULL;
+    }
+    opts.input = (rfca_node_t*)malloc( sizeof( rfca_node_t ) * opts.inputSize );
+    for( int i =0; i < opts.inputSize; i++ )
+        opts.input[i] = (rfca_node_t)getc( f ) % opts.base;
+
+    rfca_t* r = encoded ? rfca_createShape( opts ) : rfca_create( opts );
+    const rfca_buffer_t* b = r->buffer;
+    const uint64_t nodes = b->nodeCount;
+    range_decoder_t d;
+    range_decoder_init( &d, f );
+
+    const uint64_t patterns = range_decodeUniform( &d, CODEC_PATTERNS_MAX );
+    if( patterns > nodes ) {
+        fprintf( stderr, "Error: The encoded automaton is corrupt\n" );
+        free( r->opts.input );
+        rfca_free( r );
+        return NULL;
+    }
+    const int n = (int)patterns;
+    unsigned int* usage = (unsigned int*)calloc( n + 1, sizeof( unsigned int ) );
+    unsigned int* size = (unsigned int*)malloc( sizeof( unsigned int ) * (n + 1) );
+    pattern_offset_t** offsets = (pattern_offset_t**)malloc( sizeof( pattern_offset_t* ) * (n + 1) );
+    uint64_t regions =0;
+    for( int k =0; k < n; k++ ) {
+        usage[k] = (unsigned int)range_decodeUniform( &d, nodes + 1 );
+        size[k] = (unsigned int)range_decodeUniform( &d, nodes ) + 1;
+        offsets[k] = (pattern_offset_t*)malloc( sizeof( pattern_offset_t ) * size[k] );
+        for( unsigned int i =0; i < size[k]; i++ ) {
+            offsets[k][i].row = (int)range_decodeUniform( &d, 2 * b->rowCount - 1 ) - (b->rowCount - 1);
+            offsets[k][i].col = (int)range_decodeUniform( &d, 2 * b->width - 1 ) - (b->width - 1);
+            offsets[k][i].value = range_decodeUniform( &d, opts.base );
+        }
+        regions += usage[k];
+    }
+
+    // The patterns of the code table in file order, only if the regions are kept
+    pattern_t** table =NULL;
+    if( encoded ) {
+        *codeTable = (pattern_t*)malloc( sizeof( pattern_t ) );
+        INIT_LIST_HEAD( &((*codeTable)->list) );
+        (*codeTable)->size =0;
+        *encoded = (region_t*)malloc( sizeof( region_t ) );
+        (*encoded)->pattern =NULL;
+        (*encoded)->masked =false;
+        INIT_LIST_HEAD( &((*encoded)->list) );
+        table = (pattern_t**)malloc( sizeof( pattern_t* ) * (n + 1) );
+        for( int k =0; k < n; k++ ) {
+            table[k] = pattern_create( offsets[k], size[k] );
+            list_add_tail( &(table[k]->list), &((*codeTable)->list) );
+        }
+    }
+
+    uint32_t* cum = (uint32_t*)malloc( sizeof( uint32_t ) * (n + 1) );
+    const uint32_t total = codec_model( usage, n, cum );
+    uint64_t* start = codec_rowStarts( b );
+    bool valid = regions <= nodes;
+    for( uint64_t i =0; i < regions && valid; i++ ) {
+        int k;
+        if( total ) {
+            const uint32_t value = range_decodeFreq( &d, total );
+            int lo =0, hi = n - 1;
+            while( lo < hi ) {
+                const int mid = (lo + hi + 1) / 2;
+                if( cum[mid] <= value )
+                    lo = mid;
+                else
+                    hi = mid - 1;
+            }
+            k = lo;
+            range_decode( &d, cum[k], cum[k+1] - cum[k] );
+        } else
+            k = (int)range_decodeUniform( &d, n );
+        const uint64_t pivot = range_decodeUniform( &d, nodes );
+        const int variant = (int)range_decodeUniform( &d, opts.base );
+
+        int row =0, hi = b->rowCount - 1;
+        while( row < hi ) {
+            const int mid = (row + hi + 1) / 2;
+            if( start[mid] <= pivot )
+                row = mid;
+            else
+                hi = mid - 1;
+        }
+        const rfca_coord_t c = { row, (int)(pivot - start[row]) };
+        for( unsigned int j =0; j < size[k] && valid; j++ ) {
+            const rfca_coord_t abs = pattern_offset_abs( c, offsets[k][j] );
+            valid = rfca_checkBounds( r, abs );
+            if( valid && !encoded )
+                rfca_setValue( r, abs, (offsets[k][j].value + variant) % opts.base );
+        }
+        if( valid && encoded ) {
+            region_t* region = region_create( table[k], c );
+            region->variant =variant;
+            list_add_tail( &(region->list), &((*encoded)->list) );
+            table[k]->usage++;
+        }
+    }
+    if( bytes )
+        *bytes = sizeof( h ) + opts.inputSize + d.bytes;
+
+    free( start );
+    free( cum );
+    for( int k =0; k < n; k++ )
+        free( offsets[k] );
+    free( offsets );
+    free( size );
+    free( usage );
+    free( table );
+    if( !valid ) {
+        fprintf( stderr, "Error: The encoded automaton is corrupt\n" );
+        if( encoded ) {
+            region_list_free( *encoded );
+            pattern_list_free( *codeTable );
+        }
+        free( r->opts.input );
+        rfca_free( r );
+        return NULL;
+    }
+    return r;
+}
+
+/*
+ * Read an encoded automaton from f and decode it as its regions are read.
+ * Returns NULL and prints an error message if f does not hold a valid encoding.
+ * The input of the options of the returned automaton is allocated and must be freed along with it.
+ */
+rfca_t*
+codec_read( FILE* f, uint64_t* bytes ) {
+    return codec_readFile( f, bytes, NULL, NULL );
+}
+
+/*
+ * Read the code table and the regions of an encoded automaton from f without decoding it.
+ * The automaton of the returned encoding, which is also returned in shape, holds only its shape
+ * and must be freed after the encoding, along with the input of its options.
+ * Returns NULL and prints an error message if f does not hold a valid encoding.
+ */
+vouw_t*
+codec_readEncoding( FILE* f, rfca_t** shape, uint64_t* bytes ) {
+    pattern_t* codeTable;
+    region_t* encoded;
+    rfca_t* r = codec_readFile( f, bytes, &codeTable, &encoded );
+    if( !r )
+        return NULL;
+    *shape =r;
+    return vouw_createEncodedWith( r, codeTable, encoded );
+}
@@ -0,0 +1,44 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+// Range-coded files of an encoded automaton: its code table followed by its regions
+
+#include "vouw.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/* The file starts with this header and the input of the automaton, one byte per node, after which
+ * the rest of the file is range coded. The code table is coded as the number of patterns, then the usage,
+ * size and offsets of every pattern, all with uniform probabilities. Then follow the regions, which
+ * number the sum of the usages: the pattern of each region is coded with a probability proportional to its
+ * usage, the pivot and variant uniformly. This follows the model of vouw_t, except that patterns
+ * are coded by their share of the regions rather than of the nodes.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t mode;
+    int32_t base;
+    int32_t folds;
+    int32_t right;
+    int32_t inputSize;
+    uint64_t rule;              // only used to check the decoded automaton
+} codec_header_t;
+
+uint64_t
+codec_write( vouw_t* v, FILE* f );
+
+rfca_t*
+codec_read( FILE* f, uint64_t* bytes );
+
+vouw_t*
+codec_readEncoding( FILE* f, rfca_t** shape, uint64_t* bytes );
+
+#endif
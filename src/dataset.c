@@ -0,0 +1,208 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // posix_madvise()
+
+#include "dataset.h"
+#include "cli.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DATASET_MAGIC "VOUWCA"
+#define DATASET_VERSION 1
+
+typedef struct {
+    int fd;
+    const uint8_t* map;
+    size_t size;
+    const dataset_header_t* header;
+    const uint8_t* input;
+    const uint8_t* nodes;
+} dataset_t;
+
+/*
+ * Check that the header describes an automaton within the limits of the command line,
+ * with the row layout of rfca_buffer_create(), and that the file holds all of its nodes
+ */
+static bool
+dataset_checkHeader( const dataset_header_t* h, uint64_t size ) {
+    if( size < sizeof( dataset_header_t ) || memcmp( h->magic, DATASET_MAGIC, sizeof( DATASET_MAGIC ) ) != 0 ||
+        h->version != DATASET_VERSION )
+        return false;
+    if( h->base < 2 || h->base > BASE_MAX || h->mode < 2 || h->mode > MODE_MAX ||
+        h->inputSize < 1 || h->inputSize > INPUT_MAX || h->folds > FOLDS_MAX ||
+        h->width != h->inputSize + h->folds || h->rule >= rfca_maxRules( h->base, h->mode ) )
+        return false;
+
+    uint32_t rowCount =1;
+    uint64_t nodeCount = h->width;
+    for( int i = h->width; i >= (int)h->mode; ) {
+        i -= h->mode - 1;
+        rowCount++;
+        nodeCount += i;
+    }
+    return h->rowCount == rowCount && h->nodeCount == nodeCount &&
+        size >= sizeof( dataset_header_t ) + h->inputSize + nodeCount;
+}
+
+static void
+dataset_close( dataset_t* d ) {
+    if( d->map )
+        munmap( (void*)d->map, d->size );
+    if( d->fd >= 0 )
+        close( d->fd );
+}
+
+/*
+ * Map the file at path read-only, returns false and prints an error message if it cannot be used
+ */
+static bool
+dataset_open( dataset_t* d, const char* path ) {
+    memset( d, 0, sizeof( dataset_t ) );
+    d->fd = open( path, O_RDONLY );
+    struct stat st;
+    if( d->fd < 0 || fstat( d->fd, &st ) != 0 ) {
+        fprintf( stderr, "Error: Cannot open automaton file `%s'\n", path );
+        dataset_close( d );
+        return false;
+    }
+    d->size = st.st_size;
+    if( d->size >= sizeof( dataset_header_t ) ) {
+        void* map = mmap( NULL, d->size, PROT_READ, MAP_PRIVATE, d->fd, 0 );
+        d->map = map == MAP_FAILED ? NULL : (const uint8_t*)map;
+    }
+    if( !d->map || !dataset_checkHeader( (const dataset_header_t*)d->map, d->size ) ) {
+        fprintf( stderr, "Error: `%s' is not an automaton file\n", path );
+        dataset_close( d );
+        return false;
+    }
+    d->header = (const dataset_header_t*)d->map;
+    d->input = d->map + sizeof( dataset_header_t );
+    d->nodes = d->input + d->header->inputSize;
+    return true;
+}
+
+/*
+ * Write the nodes of r, which must have been generated, to a new file at path
+ */
+bool
+dataset_write( const rfca_t* r, const char* path ) {
+    FILE* f = fopen( path, "wb" );
+    if( !f ) {
+        fprintf( stderr, "Error: Cannot open `%s'\n", path );
+        return false;
+    }
+    const rfca_buffer_t* b = r->buffer;
+    dataset_header_t h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.magic, DATASET_MAGIC, sizeof( DATASET_MAGIC ) );
+    h.version =DATASET_VERSION;
+    h.base =r->opts.base;
+    h.mode =r->opts.mode;
+    h.right =r->opts.right;
+    h.rule =r->opts.rule;
+    h.inputSize =r->opts.inputSize;
+    h.folds =r->opts.folds;
+    h.width =b->width;
+    h.rowCount =b->rowCount;
+    h.nodeCount =b->nodeCount;
+    bool ok = fwrite( &h, sizeof( h ), 1, f ) == 1;
+
+    uint8_t* line = (uint8_t*)malloc( b->width > r->opts.inputSize ? b->width : r->opts.inputSize );
+    for( int i =0; i < r->opts.inputSize; i++ )
+        line[i] = (uint8_t)r->opts.input[i];
+    ok = ok && fwrite( line, 1, r->opts.inputSize, f ) == (size_t)r->opts.inputSize;
+    for( int i =0; ok && i < b->rowCount; i++ ) {
+        for( int j =0; j < b->rows[i].size; j++ )
+            line[j] = (uint8_t)b->rows[i].cols[j];
+        ok = fwrite( line, 1, b->rows[i].size, f ) == (size_t)b->rows[i].size;
+    }
+    free( line );
+    if( fclose( f ) != 0 || !ok ) {
+        fprintf( stderr, "Error: Cannot write `%s'\n", path );
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Set the options of opts to those of the automaton in the file at path, so that
+ * rfca_create() allocates an automaton of its shape and rfca_generate() reads its nodes from the file.
+ * The input of opts is allocated. Returns false and prints an error message if the file cannot be used.
+ */
+bool
+dataset_readOpts( const char* path, rfca_opts_t* opts ) {
+    dataset_t d;
+    if( !dataset_open( &d, path ) )
+        return false;
+    const dataset_header_t* h = d.header;
+    bool ok =true;
+    for( uint32_t i =0; i < h->inputSize; i++ )
+        ok = ok && d.input[i] < h->base;
+    if( !ok ) {
+        fprintf( stderr, "Error: The input in `%s' holds values that are not below base %d\n", path, h->base );
+        dataset_close( &d );
+        return false;
+    }
+
+    opts->base =h->base;
+    opts->mode =h->mode;
+    opts->right =h->right != 0;
+    opts->rule =h->rule;
+    opts->folds =h->folds;
+    opts->inputSize =h->inputSize;
+    opts->input = (rfca_node_t*)malloc( sizeof( rfca_node_t ) * h->inputSize );
+    for( uint32_t i =0; i < h->inputSize; i++ )
+        opts->input[i] = d.input[i];
+    opts->file =path;
+    dataset_close( &d );
+    return true;
+}
+
+/*
+ * Fill the nodes of r from the file r->opts.file instead of generating them.
+ * The file is mapped read-only and must hold an automaton of the shape of r.
+ * Returns false and prints an error message if it cannot be read or holds values that are not below the base.
+ */
+bool
+dataset_load( rfca_t* r ) {
+    dataset_t d;
+    if( !dataset_open( &d, r->opts.file ) )
+        return false;
+    const dataset_header_t* h = d.header;
+    rfca_buffer_t* b = r->buffer;
+    if( h->base != (uint32_t)r->opts.base || h->mode != (uint32_t)b->mode ||
+        h->width != (uint32_t)b->width || (h->right != 0) != r->opts.right ) {
+        fprintf( stderr, "Error: `%s' does not hold an automaton of the given shape\n", r->opts.file );
+        dataset_close( &d );
+        return false;
+    }
+    posix_madvise( (void*)d.map, d.size, POSIX_MADV_SEQUENTIAL );
+
+    const uint8_t* nodes = d.nodes;
+    uint8_t invalid =0;
+    for( int i =0; i < b->rowCount; i++ ) {
+        rfca_node_t* cols = b->rows[i].cols;
+        for( int j =0; j < b->rows[i].size; j++ ) {
+            invalid |= nodes[j] >= r->opts.base;
+            cols[j] = nodes[j];
+        }
+        nodes += b->rows[i].size;
+    }
+    dataset_close( &d );
+    if( invalid ) {
+        fprintf( stderr, "Error: `%s' holds values that are not below base %d\n", r->opts.file, r->opts.base );
+        return false;
+    }
+    r->folds = r->opts.folds;
+    return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef DATASET_H
+#define DATASET_H
+
+// Files that hold the nodes of an automaton, so it can be read instead of generated
+
+#include "rfca.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The file starts with this header, followed by inputSize bytes with the input as given by -i,
+ * followed by nodeCount bytes with the value of every node. The nodes are stored row after row
+ * in the order of rfca_buffer_t: row i holds width - i*(mode-1) nodes, and the rows of a
+ * left-folding automaton are mirrored, as in memory. Integers are stored in the byte order
+ * of the machine that wrote them.
+ * Any triangular data with values below base can be stored this way; rule is then only a label.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t base;
+    uint32_t mode;
+    uint32_t right;
+    uint64_t rule;
+    uint32_t inputSize;
+    uint32_t folds;
+    uint32_t width;             // inputSize + folds
+    uint32_t rowCount;
+    uint64_t nodeCount;
+} dataset_header_t;
+
+bool
+dataset_write( const rfca_t* r, const char* path );
+
+bool
+dataset_readOpts( const char* path, rfca_opts_t* opts );
+
+bool
+dataset_load( rfca_t* r );
+
+#endif
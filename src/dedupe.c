@@ -0,0 +1,138 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "dedupe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+dedupe_t*
+dedupe_create( void ) {
+    dedupe_t* d = (dedupe_t*)malloc( sizeof( dedupe_t ) );
+    d->capacity =1024;
+    d->buckets = (dedupe_entry_t**)calloc( d->capacity, sizeof( dedupe_entry_t* ) );
+    d->count =0;
+    d->lookups =0;
+    d->hits =0;
+    pthread_mutex_init( &d->lock, NULL );
+    pthread_cond_init( &d->cond, NULL );
+    return d;
+}
+
+void
+dedupe_free( dedupe_t* d ) {
+    for( uint64_t i =0; i < d->capacity; i++ ) {
+        dedupe_entry_t* e = d->buckets[i];
+        while( e ) {
+            dedupe_entry_t* next = e->next;
+            free( e->nodes );
+            free( e );
+            e = next;
+        }
+    }
+    pthread_mutex_destroy( &d->lock );
+    pthread_cond_destroy( &d->cond );
+    free( d->buckets );
+    free( d );
+}
+
+static bool
+dedupe_isEqual( const dedupe_entry_t* e, const rfca_buffer_t* b ) {
+    const uint8_t* n = e->nodes;
+    for( int i =0; i < b->rowCount; i++ ) {
+        for( int j =0; j < b->rows[i].size; j++ )
+            if( *n++ != (uint8_t)b->rows[i].cols[j] )
+                return false;
+    }
+    return true;
+}
+
+static void
+dedupe_grow( dedupe_t* d ) {
+    uint64_t capacity = d->capacity * 2;
+    dedupe_entry_t** buckets = (dedupe_entry_t**)calloc( capacity, sizeof( dedupe_entry_t* ) );
+    for( uint64_t i =0; i < d->capacity; i++ ) {
+        dedupe_entry_t* e = d->buckets[i];
+        while( e ) {
+            dedupe_entry_t* next = e->next;
+            e->next = buckets[e->hash & (capacity-1)];
+            buckets[e->hash & (capacity-1)] = e;
+            e = next;
+        }
+    }
+    free( d->buckets );
+    d->buckets = buckets;
+    d->capacity = capacity;
+}
+
+/*
+ * Look up an automaton with the same nodes as r, which was generated by rule.
+ * If one was added before, found is set to true and its entry is returned once its
+ * result has been published. Otherwise a new entry is added and returned with found set to false,
+ * the caller must then compute the result and pass it to dedupe_publish().
+ * All automata must have the same shape and nodes smaller than 256.
+ */
+dedupe_entry_t*
+dedupe_acquire( dedupe_t* d, const rfca_t* r, uint64_t rule, bool* found ) {
+    const uint64_t hash = rfca_buffer_hash( r->buffer );
+
+    pthread_mutex_lock( &d->lock );
+    d->lookups++;
+    dedupe_entry_t* e = d->buckets[hash & (d->capacity-1)];
+    for( ; e; e = e->next ) {
+        if( e->hash == hash && dedupe_isEqual( e, r->buffer ) )
+            break;
+    }
+
+    if( e ) {
+        d->hits++;
+        while( !e->ready )
+            pthread_cond_wait( &d->cond, &d->lock );
+        pthread_mutex_unlock( &d->lock );
+        *found =true;
+        return e;
+    }
+
+    if( d->count >= d->capacity )
+        dedupe_grow( d );
+    e = (dedupe_entry_t*)malloc( sizeof( dedupe_entry_t ) );
+    e->hash = hash;
+    e->rule = rule;
+    e->ready =false;
+    e->value =0.0;
+    e->nodes = (uint8_t*)malloc( r->buffer->nodeCount );
+    uint8_t* n = e->nodes;
+    for( int i =0; i < r->buffer->rowCount; i++ )
+        for( int j =0; j < r->buffer->rows[i].size; j++ )
+            *n++ = (uint8_t)r->buffer->rows[i].cols[j];
+    e->next = d->buckets[hash & (d->capacity-1)];
+    d->buckets[hash & (d->capacity-1)] = e;
+    d->count++;
+    pthread_mutex_unlock( &d->lock );
+
+    *found =false;
+    return e;
+}
+
+/*
+ * Store the result for an entry returned by dedupe_acquire() and wake up threads waiting for it
+ */
+void
+dedupe_publish( dedupe_t* d, dedupe_entry_t* e, double value ) {
+    pthread_mutex_lock( &d->lock );
+    e->value = value;
+    e->ready =true;
+    pthread_cond_broadcast( &d->cond );
+    pthread_mutex_unlock( &d->lock );
+}
+
+void
+dedupe_printStats( const dedupe_t* d, FILE* f ) {
+    fprintf( f, "Identical automata: %"PRIu64" of %"PRIu64" rules (%.1f%%), %"PRIu64" distinct\n",
+        d->hits, d->lookups, d->lookups ? (double)d->hits / (double)d->lookups * 100.0 : 0.0, d->count );
+}
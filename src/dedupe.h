@@ -0,0 +1,54 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef DEDUPE_H
+#define DEDUPE_H
+
+// Detection of rules that generate exactly the same automaton, so their results can be shared
+
+#include "rfca.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct dedupe_entry {
+    struct dedupe_entry* next;
+    uint64_t hash;
+    uint64_t rule;      // the first rule that generated this automaton
+    uint8_t* nodes;     // its node values, to tell hash collisions apart
+    double value;       // result stored by dedupe_publish()
+    bool ready;
+} dedupe_entry_t;
+
+/* A hash table of generated automata that can be shared by multiple threads */
+typedef struct {
+    dedupe_entry_t** buckets;
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t lookups;
+    uint64_t hits;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} dedupe_t;
+
+dedupe_t*
+dedupe_create( void );
+
+void
+dedupe_free( dedupe_t* d );
+
+dedupe_entry_t*
+dedupe_acquire( dedupe_t* d, const rfca_t* r, uint64_t rule, bool* found );
+
+void
+dedupe_publish( dedupe_t* d, dedupe_entry_t* e, double value );
+
+void
+dedupe_printStats( const dedupe_t* d, FILE* f );
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "distance.h"
+#include "vouw.h"
+#include "cache.h"
+
+/*
+ * Generate rule i and build its cross-encoding target
+ */
+void
+distance_generate( void* arg, uint64_t i, int worker ) {
+    (void)worker;
+    distance_ctx_t* ctx = (distance_ctx_t*)arg;
+    distance_rule_t* dr = &ctx->rules[i];
+    rfca_opts_t opts = ctx->opts;
+    opts.rule = i;
+    dr->rfca = rfca_create( opts );
+    rfca_generate( dr->rfca );
+    dr->target = vouw_target_create( dr->rfca );
+    dr->v =NULL;
+    dr->compressed =0.0;
+    dr->encode =false;
+}
+
+/*
+ * Returns true if the cache holds the cross-encodings of all distinct targets with the code table of rule i
+ */
+static bool
+distance_isCached( distance_ctx_t* ctx, uint64_t i ) {
+    double compressed_using;
+    for( uint64_t j =0; j < ctx->count; j++ ) {
+        if( ctx->rules[j].same == j &&
+            !cache_findCross( ctx->cache, &ctx->rules[i].rfca->opts, &ctx->rules[j].rfca->opts, &compressed_using ) )
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Self-encode rule i if its code table is used for one or more rows
+ */
+void
+distance_selfEncode( void* arg, uint64_t i, int worker ) {
+    (void)worker;
+    distance_ctx_t* ctx = (distance_ctx_t*)arg;
+    distance_rule_t* dr = &ctx->rules[i];
+    if( !dr->encode )
+        return;
+
+    // The code table itself is only needed if not all of its cross-encodings are cached
+    cache_self_t self;
+    const bool haveSelf = ctx->cache && cache_findSelf( ctx->cache, &dr->rfca->opts, &self );
+    if( haveSelf && !ctx->lazy && distance_isCached( ctx, i ) ) {
+        dr->compressed = self.compressed;
+        return;
+    }
+
+    dr->v = vouw_createFrom( dr->rfca );
+    self.uncompressed = dr->v->ctBits + dr->v->encodedBits;
+    self.steps = vouw_encode( dr->v );
+    dr->compressed = dr->v->ctBits + dr->v->encodedBits;
+    if( ctx->cache && !haveSelf ) {
+        self.compressed = dr->compressed;
+        self.digest = pattern_list_digest( dr->v->codeTable );
+        cache_storeSelf( ctx->cache, &dr->rfca->opts, &self );
+    }
+}
+
+/*
+ * Returns the cross-encoding ratio of rule j encoded with the code table of rule i, which must be self-encoded,
+ * as printed by `encode-all using -r i'
+ */
+double
+distance_cross( distance_ctx_t* ctx, uint64_t i, uint64_t j, int worker ) {
+    const distance_rule_t* source = &ctx->rules[i];
+    const distance_rule_t* t = &ctx->rules[j];
+    double compressed_using;
+    if( !ctx->cache || !cache_findCross( ctx->cache, &source->rfca->opts, &t->rfca->opts, &compressed_using ) ) {
+        compressed_using = vouw_crossEncodedLength( t->target, source->v->codeTable, ctx->scratch[worker], NULL, NULL );
+        if( ctx->cache )
+            cache_storeCross( ctx->cache, &source->rfca->opts, &t->rfca->opts, compressed_using );
+    }
+    return (compressed_using - t->compressed) / t->compressed;
+}
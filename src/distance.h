@@ -0,0 +1,55 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+// Cross-encoding distances of the rules of a rulespace, shared by distance-matrix and cluster
+
+#include "vouw.h"
+#include "symmetry.h"
+#include "cache.h"
+#include "matrix.h"
+
+// Number of rows and columns in one tile of the distance matrix
+#define DISTANCE_TILE 16
+
+typedef struct {
+    rfca_t* rfca;
+    vouw_t* v;              // self-encoding, holds the rule's code table, canonical rules only
+    vouw_target_t* target;
+    double compressed;      // encoded length using its own code table
+    uint64_t canonical;     // equivalent rule under the symmetry group
+    int map;                // the map of the symmetry group that takes this rule to canonical
+    uint64_t same;          // first rule that generates the same automaton
+    uint64_t source;        // rule whose self-encoding is used for this rule's row
+    bool encode;            // set if this rule is the source of any row
+} distance_rule_t;
+
+typedef struct {
+    rfca_opts_t opts;
+    distance_rule_t* rules;
+    uint64_t count;
+    uint64_t band;          // first row of the band that is being computed
+    double* values;         // DISTANCE_TILE rows of count values, indexed by slot and distinct target
+    uint64_t slots[DISTANCE_TILE]; // distinct sources of the rows in the band
+    int slotOf[DISTANCE_TILE];      // slot of every row in the band
+    int slotCount;
+    matrix_t* store;        // optional, written instead of the text output
+    vouw_scratch_t** scratch; // one per worker
+    cache_t* cache;         // optional, results of earlier runs
+    bool lazy;              // set if it is not known in advance which pairs are computed
+    symmetry_group_t group;
+    uint64_t* perm[SYMMETRY_MAX]; // the image of every rule under each map of group
+} distance_ctx_t;
+
+void
+distance_generate( void* arg, uint64_t i, int worker );void
+distance_selfEncode( void* arg, uint64_t i, int worker );double
+distance_cross( distance_ctx_t* ctx, uint64_t i, uint64_t j, int worker );
+
+#endif
@@ -19,6 +19,10 @@
 #include "module_print.h"
 #include "module_encode.h"
 #include "module_batch.h"
+#include "module_distance.h"
+#include "module_nearest.h"
+#include "module_cluster.h"
+#include "module_matrix.h"
 
 int
 main( int _argc, char** _argv ) {
@@ -32,6 +36,7 @@ main( int _argc, char** _argv ) {
     opts.right =false;
     opts.rule =0;
     opts.input = NULL;
+    opts.file = NULL;
     opts.base =BASE_DEFAULT;
     opts.folds =FOLDS_DEFAULT;
     const char* param_module = NULL;
@@ -39,9 +44,14 @@ main( int _argc, char** _argv ) {
     // Add all module functions
     module_t modulePrint = {
         "print",
-        "Prints the raw output generated by the automaton.",
+        "Prints the raw output generated by the automaton. With --plain, nodes are printed without indentation and separators, with --raw the node values are written as bytes, row after row without line breaks.",
         &module_print };
     module_register( &modulePrint );
+    module_t moduleGenerate = {
+        "generate",
+        "Generate the automaton and write it to the given file, one byte per node. Every module reads it back with --from-file FILE instead of generating it.",
+        &module_generate };
+    module_register( &moduleGenerate );
     module_t moduleTTable = {
         "ttable",
         "Only print the transition table for a given configuration.",
@@ -54,14 +64,59 @@ main( int _argc, char** _argv ) {
     module_register( &moduleTTable2 );
     module_t moduleencode = {
         "encode",
-        "encode the given automaton using the vouw algorithm. optionally, specify another automaton with `using' to cross-encode.",
+        "encode the given automaton using the vouw algorithm. optionally, specify another automaton with `using' to cross-encode. With --out FILE, before `using', the encoding is also written to FILE with a range coder and its size is compared to the estimated length. With --log FILE, before `using', every merge is appended to FILE; the merges in an existing log are replayed without searching for candidates, and an encoding that was cut short is resumed from there.",
         &module_encode };
     module_register( &moduleencode );
+    module_t moduledecode = {
+        "decode",
+        "Decode and print an automaton that was written by `encode --out' to the given file, or - for the standard input, and report the decoding speed. With --verify, compare it to the automaton generated from the same options; with --quiet, do not print it.",
+        &module_decode };
+    module_register( &moduledecode );
+    module_t modulequery = {
+        "query",
+        "Read an encoding that was written by `encode --out' from the given file, or - for the standard input, followed by nodes given as ROW,COL and windows given as FIRSTROW,FIRSTCOL:LASTROW,LASTCOL. Print their values, found from the regions of the encoding that cover them instead of decoding the automaton. Nodes outside of the automaton are printed as dots. With --verify, before the file, compare every value to the automaton generated from the same options.",
+        &module_query };
+    module_register( &modulequery );
+    module_t moduleencodetiles = {
+        "encode-tiles",
+        "Encode only a window of the automaton, given by --rows FIRST-LAST and --columns FIRST-LAST, and print the compression ratio of every tile. The window is split into tiles of --tile-size ROWS,COLS, or tiles are given one by one with --tile ROW,COL:ROW,COL. Every tile gets its own code table and tiles are encoded in parallel on -j threads. With --merge, the code tables of the tiles are combined into one that covers the entire automaton.",
+        &module_encodeTiles };
+    module_register( &moduleencodetiles );
     module_t moduleencodeall = {
         "encode-all",
-        "Encode the entire specified rulespace using VOUW and print the compresion ratio for each rule.",
+        "Encode the entire specified rulespace using VOUW and print the compresion ratio for each rule. Rules pass through a pipeline of generate, self-encode, cross-encode and output stages: -j sets the number of self-encoding threads, --generate-threads and --cross-threads the number of threads of the other stages (default 1 and the same as -j). Use --range FIRST-LAST or --shard k/N to encode part of the rulespace and --checkpoint FILE to save results as they complete and resume from them. Rules that are equivalent under a relabeling of values are encoded once, unless --no-symmetry is given. Rules that generate the same automaton share their result, unless --no-dedupe is given. With --cache FILE, results of earlier runs are read from FILE and new results are added to it. With --output-format bin, fixed-width binary records are written instead of text, see convert-results.",
         &module_encodeAll };
     module_register( &moduleencodeall );
+    module_t modulemergecheckpoints = {
+        "merge-checkpoints",
+        "Combine the checkpoint files of encode-all runs and print the results as if encode-all ran over the entire rulespace.",
+        &module_mergeCheckpoints };
+    module_register( &modulemergecheckpoints );
+    module_t moduleconvertresults = {
+        "convert-results",
+        "Print the binary results written by encode-all with --output-format bin, read from the given file or - for the standard input, in the text format of encode-all. With --fields, print the rule, result, uncompressed and compressed length in bits, steps, code table size and encoding time of every rule.",
+        &module_convertResults };
+    module_register( &moduleconvertresults );
+    module_t moduledistancematrix = {
+        "distance-matrix",
+        "Cross-encode every pair of rules in the specified rulespace, optionally on -j threads. Prints the same matrix as `encode-all using' for every rule. Accepts --no-symmetry, --no-dedupe and --cache FILE like encode-all. With --store FILE, the matrix is written to a tiled binary matrix store instead, which can be resumed and is read by `matrix'.",
+        &module_distanceMatrix };
+    module_register( &moduledistancematrix );
+    module_t modulenearest = {
+        "nearest",
+        "Print the -k rules (default 10) of the specified rulespace that are nearest to the rule given by -r, in the measure of `encode-all using', with their distance and sketch similarity. Every rule is self-encoded once and summarized by a MinHash sketch of its code table, which is kept in the file given by --sketches FILE for later queries. Rules are cross-encoded in order of their distance estimated from the sketches and given up as soon as they cannot be among the nearest. With --shortlist N only the N rules with the smallest estimates are cross-encoded, which is faster but approximate. Use -j to set the number of threads.",
+        &module_nearest };
+    module_register( &modulenearest );
+    module_t modulecluster = {
+        "cluster",
+        "Cluster the rules of the specified rulespace by the mean of their cross-encoding ratios in both directions, or 0 if that is negative. With -k K, partition the rules around K medoids and print the cluster and medoid of every rule; the first medoid is the rule given by -r, the others are drawn using --seed N. Only the distances that are needed are computed. With --dendrogram FILE, compute all distances and write the hierarchy of --linkage single, complete or average (default) to FILE. With --store FILE, compute all distances and keep them in a symmetric matrix store, which later runs read instead of encoding. Accepts -j, --iterations N and --cache FILE.",
+        &module_cluster };
+    module_register( &modulecluster );
+    module_t modulematrix = {
+        "matrix",
+        "Print rows and columns of the matrix store given by --store FILE, written by distance-matrix or cluster, in the text format of distance-matrix. Select a block with --rows FIRST-LAST and --columns FIRST-LAST, or a single row or column with --rows I or --columns J; by default the entire matrix is exported.",
+        &module_matrix };
+    module_register( &modulematrix );
 
     // The module is always the first argument
     if( argc == 1 ) {
@@ -0,0 +1,293 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "match.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATCH_X86
+#include <immintrin.h>
+#endif
+
+typedef uint32_t (*match_kernel_t)( const pattern_t*, const match_plane_t*, const match_plane_t*, int, int, int );
+
+static uint32_t
+lanemask( int count ) {
+    return count >= 32 ? 0xffffffffu : (1u << count) - 1;
+}
+
+/*
+ * Reference implementation, tests count pivots one at a time.
+ * A node at offset k matches if (value_k - p_k) == (value_0 - p_0) modulo base.
+ */
+static uint32_t
+match_row_scalar( const pattern_t* p, const match_plane_t* pl, const match_plane_t* mask, int row, int col, int count ) {
+    const int base = pl->base;
+    uint32_t m =0;
+    for( int l =0; l < count; l++ ) {
+        bool match =true;
+        int v =0;
+        for( unsigned int k =0; k < p->size && match; k++ ) {
+            const pattern_offset_t* o = &p->offsets[k];
+            const int c = col + l + o->col;
+            if( mask->rows[row + o->row][c] ) {
+                match =false;
+                break;
+            }
+            int d = (pl->rows[row + o->row][c] + base - (int)o->value) % base;
+            if( k == 0 )
+                v = d;
+            else if( d != v )
+                match =false;
+        }
+        if( match )
+            m |= 1u << l;
+    }
+    return m;
+}
+
+#ifdef MATCH_X86
+
+/*
+ * Computes (x + (base - value)) mod base for each byte in x, given x < base and value < base.
+ * The sum lies in [1,2*base), subtracting base either yields the remainder
+ * or wraps around to a value larger than the sum, hence the unsigned minimum.
+ */
+__attribute__((target("sse2")))
+static __m128i
+residue_sse2( __m128i x, __m128i vbase, int base, int value ) {
+    __m128i d = _mm_add_epi8( x, _mm_set1_epi8( (char)(base - value) ) );
+    return _mm_min_epu8( d, _mm_sub_epi8( d, vbase ) );
+}
+
+__attribute__((target("sse2")))
+static uint32_t
+match_row_sse2( const pattern_t* p, const match_plane_t* pl, const match_plane_t* mask, int row, int col, int count ) {
+    const __m128i vbase = _mm_set1_epi8( (char)pl->base );
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t result =0;
+
+    for( int l =0; l < count; l += 16 ) {
+        const pattern_offset_t* o = &p->offsets[0];
+        int c = col + l + o->col;
+        __m128i x = _mm_loadu_si128( (const __m128i*)(pl->rows[row + o->row] + c) );
+        __m128i m = _mm_loadu_si128( (const __m128i*)(mask->rows[row + o->row] + c) );
+        const __m128i d0 = residue_sse2( x, vbase, pl->base, (int)o->value );
+        __m128i acc = _mm_cmpeq_epi8( m, zero );
+
+        for( unsigned int k =1; k < p->size; k++ ) {
+            o = &p->offsets[k];
+            c = col + l + o->col;
+            x = _mm_loadu_si128( (const __m128i*)(pl->rows[row + o->row] + c) );
+            m = _mm_loadu_si128( (const __m128i*)(mask->rows[row + o->row] + c) );
+            __m128i d = residue_sse2( x, vbase, pl->base, (int)o->value );
+            acc = _mm_and_si128( acc, _mm_and_si128( _mm_cmpeq_epi8( d, d0 ), _mm_cmpeq_epi8( m, zero ) ) );
+        }
+        result |= (uint32_t)(_mm_movemask_epi8( acc ) & 0xffff) << l;
+    }
+    return result & lanemask( count );
+}
+
+__attribute__((target("avx2")))
+static __m256i
+residue_avx2( __m256i x, __m256i vbase, int base, int value ) {
+    __m256i d = _mm256_add_epi8( x, _mm256_set1_epi8( (char)(base - value) ) );
+    return _mm256_min_epu8( d, _mm256_sub_epi8( d, vbase ) );
+}
+
+__attribute__((target("avx2")))
+static uint32_t
+match_row_avx2( const pattern_t* p, const match_plane_t* pl, const match_plane_t* mask, int row, int col, int count ) {
+    const __m256i vbase = _mm256_set1_epi8( (char)pl->base );
+    const __m256i zero = _mm256_setzero_si256();
+
+    const pattern_offset_t* o = &p->offsets[0];
+    int c = col + o->col;
+    __m256i x = _mm256_loadu_si256( (const __m256i*)(pl->rows[row + o->row] + c) );
+    __m256i m = _mm256_loadu_si256( (const __m256i*)(mask->rows[row + o->row] + c) );
+    const __m256i d0 = residue_avx2( x, vbase, pl->base, (int)o->value );
+    __m256i acc = _mm256_cmpeq_epi8( m, zero );
+
+    for( unsigned int k =1; k < p->size; k++ ) {
+        o = &p->offsets[k];
+        c = col + o->col;
+        x = _mm256_loadu_si256( (const __m256i*)(pl->rows[row + o->row] + c) );
+        m = _mm256_loadu_si256( (const __m256i*)(mask->rows[row + o->row] + c) );
+        __m256i d = residue_avx2( x, vbase, pl->base, (int)o->value );
+        acc = _mm256_and_si256( acc, _mm256_and_si256( _mm256_cmpeq_epi8( d, d0 ), _mm256_cmpeq_epi8( m, zero ) ) );
+    }
+    return (uint32_t)_mm256_movemask_epi8( acc ) & lanemask( count );
+}
+
+#endif
+
+static match_kernel_t match_kernel = NULL;
+static const char* match_kernel_name = "scalar";
+static pthread_once_t match_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Select the widest kernel supported by the CPU we're running on.
+ * The environment variable VOUW_MATCH_KERNEL can be set to `scalar', `sse2' or `avx2'
+ * in order to force a narrower kernel.
+ */
+static void
+match_selectOnce( void ) {
+    const char* force = getenv( "VOUW_MATCH_KERNEL" );
+    match_kernel_t k = match_row_scalar;
+    const char* name = "scalar";
+#ifdef MATCH_X86
+    __builtin_cpu_init();
+    if( (!force || strcmp( force, "avx2" ) == 0) && __builtin_cpu_supports( "avx2" ) ) {
+        k = match_row_avx2;
+        name = "avx2";
+    } else if( (!force || strcmp( force, "scalar" ) != 0) && __builtin_cpu_supports( "sse2" ) ) {
+        k = match_row_sse2;
+        name = "sse2";
+    }
+#endif
+    match_kernel_name = name;
+    match_kernel = k;
+}
+
+static void
+match_select( void ) {
+    pthread_once( &match_once, match_selectOnce );
+}
+
+static match_plane_t*
+match_plane_alloc( int rowCount, const int* rowSize, int nodeCount, int base ) {
+    match_select();
+
+    match_plane_t* pl = (match_plane_t*)malloc( sizeof( match_plane_t ) );
+    pl->rowCount = rowCount;
+    pl->base = base;
+    pl->nodeCount = nodeCount;
+    pl->rowSize = (int*)malloc( sizeof( int ) * rowCount );
+    pl->rows = (uint8_t**)malloc( sizeof( uint8_t* ) * rowCount );
+
+    // All rows share a single allocation, followed by padding for the kernels
+    pl->data = (uint8_t*)calloc( nodeCount + MATCH_MAX_LANES, 1 );
+
+    uint8_t* row = pl->data;
+    for( int i =0; i < rowCount; i++ ) {
+        pl->rowSize[i] = rowSize[i];
+        pl->rows[i] = row;
+        row += rowSize[i];
+    }
+    return pl;
+}
+
+/*
+ * Make a byte-per-node copy of r in logical coordinates
+ */
+match_plane_t*
+match_plane_create( const rfca_t* r ) {
+    const rfca_buffer_t* b = r->buffer;
+    int rowSize[b->rowCount];
+    for( int i =0; i < b->rowCount; i++ )
+        rowSize[i] = b->rows[i].size;
+    match_plane_t* pl = match_plane_alloc( b->rowCount, rowSize, b->nodeCount, r->opts.base );
+    match_plane_copyFrom( pl, r );
+    return pl;
+}
+
+/*
+ * Overwrite pl with the nodes of r, which must have the same shape
+ */
+void
+match_plane_copyFrom( match_plane_t* pl, const rfca_t* r ) {
+    const rfca_buffer_t* b = r->buffer;
+    for( int i =0; i < b->rowCount; i++ ) {
+        const int size = b->rows[i].size;
+        const rfca_node_t* cols = b->rows[i].cols;
+        uint8_t* values = pl->rows[i];
+        for( int j =0; j < size; j++ ) {
+            // Left-folding automata are stored mirrored, see transpose()
+            rfca_node_t value = r->opts.right ? cols[j] : cols[(size-1) - j];
+            values[j] = (uint8_t)(value & ~RFCA_MASKED_VALUE);
+        }
+    }
+}
+
+/*
+ * Create an all-zero plane with the same shape as pl, to be used as a mask
+ */
+match_plane_t*
+match_plane_createLike( const match_plane_t* pl ) {
+    return match_plane_alloc( pl->rowCount, pl->rowSize, pl->nodeCount, pl->base );
+}
+
+void
+match_plane_clear( match_plane_t* pl ) {
+    memset( pl->data, 0, pl->nodeCount );
+}
+
+void
+match_plane_free( match_plane_t* pl ) {
+    free( pl->data );
+    free( pl->rows );
+    free( pl->rowSize );
+    free( pl );
+}
+
+/*
+ * Number of pivots that can be tested by a single kernel invocation
+ */
+int
+match_laneCount( void ) {
+    match_select();
+    return MATCH_MAX_LANES;
+}
+
+const char*
+match_kernelName( void ) {
+    match_select();
+    return match_kernel_name;
+}
+
+/*
+ * Test p against the pivots {row,col} .. {row,col+count-1} of pl at once.
+ * Returns a bit mask with bit l set if p matches nodes at pivot {row,col+l} for any variant,
+ * and none of these nodes are set in mask. The caller must make sure all pivots lie
+ * within pattern_rowBounds() and count <= MATCH_MAX_LANES.
+ */
+uint32_t
+match_row( const pattern_t* p, const match_plane_t* pl, const match_plane_t* mask, int row, int col, int count ) {
+    return match_kernel( p, pl, mask, row, col, count );
+}
+
+/*
+ * Returns true if none of the nodes covered by p at pivot are masked
+ */
+bool
+match_isFree( const pattern_t* p, const match_plane_t* mask, rfca_coord_t pivot ) {
+    for( unsigned int k =0; k < p->size; k++ ) {
+        rfca_coord_t c = pattern_offset_abs( pivot, p->offsets[k] );
+        if( mask->rows[c.row][c.col] )
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Returns the variant with which p matches at pivot
+ */
+int
+match_variant( const pattern_t* p, const match_plane_t* pl, rfca_coord_t pivot ) {
+    rfca_coord_t c = pattern_offset_abs( pivot, p->offsets[0] );
+    return (pl->rows[c.row][c.col] + pl->base - (int)p->offsets[0].value) % pl->base;
+}
+
+void
+match_setMasked( const pattern_t* p, match_plane_t* mask, rfca_coord_t pivot ) {
+    for( unsigned int k =0; k < p->size; k++ ) {
+        rfca_coord_t c = pattern_offset_abs( pivot, p->offsets[k] );
+        mask->rows[c.row][c.col] =1;
+    }
+}
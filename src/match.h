@@ -0,0 +1,68 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef MATCH_H
+#define MATCH_H
+
+// Vectorized pattern matching over a compact copy of an automaton
+
+#include "rfca.h"
+#include "pattern.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Maximum number of pivots tested by a single call to match_row()
+#define MATCH_MAX_LANES 32
+
+/* One byte per node in logical (untransposed) coordinates.
+ * The same structure is used for node values and for masks, in which a non-zero byte
+ * means the node is already covered by a region. Rows are stored back to back with padding
+ * at the end, so the kernels may read up to MATCH_MAX_LANES bytes past the end of any row.
+ */
+typedef struct {
+    uint8_t** rows;
+    int* rowSize;
+    int rowCount;
+    int base;
+    int nodeCount;
+    uint8_t* data;
+} match_plane_t;
+
+match_plane_t*
+match_plane_create( const rfca_t* r );
+
+void
+match_plane_copyFrom( match_plane_t* pl, const rfca_t* r );
+
+match_plane_t*
+match_plane_createLike( const match_plane_t* pl );
+
+void
+match_plane_clear( match_plane_t* pl );
+
+void
+match_plane_free( match_plane_t* pl );
+
+int
+match_laneCount( void );
+
+const char*
+match_kernelName( void );
+
+uint32_t
+match_row( const pattern_t* p, const match_plane_t* pl, const match_plane_t* mask, int row, int col, int count );
+
+bool
+match_isFree( const pattern_t* p, const match_plane_t* mask, rfca_coord_t pivot );
+
+int
+match_variant( const pattern_t* p, const match_plane_t* pl, rfca_coord_t pivot );
+
+void
+match_setMasked( const pattern_t* p, match_plane_t* mask, rfca_coord_t pivot );
+
+#endif
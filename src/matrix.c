@@ -0,0 +1,243 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // ftruncate()
+
+#include "matrix.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MATRIX_MAGIC "VOUWMAT"
+#define MATRIX_VERSION 1
+// Tiles start at a multiple of the page size
+#define MATRIX_ALIGN 4096
+
+static uint64_t
+matrix_align( uint64_t offset ) {
+    return (offset + MATRIX_ALIGN - 1) / MATRIX_ALIGN * MATRIX_ALIGN;
+}
+
+static uint64_t
+matrix_flagsOffset( void ) {
+    return matrix_align( sizeof( matrix_header_t ) );
+}
+
+static uint64_t
+matrix_tilesOffset( uint64_t tileCount ) {
+    return matrix_align( matrix_flagsOffset() + tileCount );
+}
+
+static uint64_t
+matrix_tileCount( uint64_t count, int tileSize, bool symmetric ) {
+    const uint64_t tpr = (count + tileSize - 1) / tileSize;
+    return symmetric ? tpr * (tpr + 1) / 2 : tpr * tpr;
+}
+
+/*
+ * Map the file of m, whose fields count, tileSize and symmetric are set
+ */
+static bool
+matrix_map( matrix_t* m ) {
+    m->tilesPerRow = (m->count + m->tileSize - 1) / m->tileSize;
+    m->tileCount = matrix_tileCount( m->count, m->tileSize, m->symmetric );
+    m->size = matrix_tilesOffset( m->tileCount ) + m->tileCount * (uint64_t)m->tileSize * m->tileSize * sizeof( double );
+    m->map = (uint8_t*)mmap( NULL, m->size, m->writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m->fd, 0 );
+    if( m->map == MAP_FAILED ) {
+        m->map =NULL;
+        return false;
+    }
+    m->header = (const matrix_header_t*)m->map;
+    m->done = m->map + matrix_flagsOffset();
+    m->tiles = (double*)(m->map + matrix_tilesOffset( m->tileCount ));
+    return true;
+}
+
+static bool
+matrix_checkHeader( const matrix_header_t* h, uint64_t size ) {
+    if( size < sizeof( matrix_header_t ) || memcmp( h->magic, MATRIX_MAGIC, sizeof( MATRIX_MAGIC ) ) != 0 ||
+        h->version != MATRIX_VERSION || h->tileSize == 0 )
+        return false;
+    const uint64_t tileCount = matrix_tileCount( h->count, h->tileSize, h->symmetric );
+    return h->tileCount == tileCount &&
+        size >= matrix_tilesOffset( tileCount ) + tileCount * (uint64_t)h->tileSize * h->tileSize * sizeof( double );
+}
+
+static matrix_t*
+matrix_alloc( void ) {
+    matrix_t* m = (matrix_t*)calloc( 1, sizeof( matrix_t ) );
+    m->fd =-1;
+    return m;
+}
+
+/*
+ * Open a store for writing. An existing store is resumed if it has the same shape and description,
+ * so that tiles that are done can be skipped; otherwise a new store is created with all tiles missing.
+ * Returns NULL and prints an error message if the file cannot be used.
+ */
+matrix_t*
+matrix_create( const char* path, uint64_t count, int tileSize, bool symmetric, const char* description ) {
+    matrix_t* m = matrix_alloc();
+    m->writable =true;
+    m->fd = open( path, O_RDWR | O_CREAT, 0644 );
+    struct stat st;
+    if( m->fd < 0 || fstat( m->fd, &st ) != 0 ) {
+        fprintf( stderr, "Error: Cannot open matrix store `%s'\n", path );
+        matrix_close( m );
+        return NULL;
+    }
+
+    if( st.st_size > 0 ) {
+        matrix_header_t h;
+        if( pread( m->fd, &h, sizeof( h ), 0 ) != sizeof( h ) || !matrix_checkHeader( &h, st.st_size ) ||
+            h.count != count || h.tileSize != (uint32_t)tileSize || (h.symmetric != 0) != symmetric ||
+            strncmp( h.description, description, MATRIX_DESCRIPTION_MAX ) != 0 ) {
+            fprintf( stderr, "Error: `%s' is not a matrix store of this run\n", path );
+            matrix_close( m );
+            return NULL;
+        }
+    }
+
+    m->count =count;
+    m->tileSize =tileSize;
+    m->symmetric =symmetric;
+    if( st.st_size == 0 ) {
+        const uint64_t tileCount = matrix_tileCount( count, tileSize, symmetric );
+        const uint64_t size = matrix_tilesOffset( tileCount ) + tileCount * (uint64_t)tileSize * tileSize * sizeof( double );
+        if( ftruncate( m->fd, size ) != 0 ) {
+            fprintf( stderr, "Error: Cannot allocate %llu bytes for matrix store `%s'\n", (unsigned long long)size, path );
+            matrix_close( m );
+            return NULL;
+        }
+    }
+    if( !matrix_map( m ) ) {
+        fprintf( stderr, "Error: Cannot map matrix store `%s'\n", path );
+        matrix_close( m );
+        return NULL;
+    }
+    if( st.st_size == 0 ) {
+        matrix_header_t* h = (matrix_header_t*)m->map;
+        memcpy( h->magic, MATRIX_MAGIC, sizeof( MATRIX_MAGIC ) );
+        h->version =MATRIX_VERSION;
+        h->tileSize =tileSize;
+        h->count =count;
+        h->symmetric =symmetric;
+        h->tileCount =m->tileCount;
+        strncpy( h->description, description, MATRIX_DESCRIPTION_MAX -1 );
+    }
+    return m;
+}
+
+/*
+ * Open an existing store for reading, returns NULL and prints an error message if it cannot be used
+ */
+matrix_t*
+matrix_open( const char* path ) {
+    matrix_t* m = matrix_alloc();
+    m->fd = open( path, O_RDONLY );
+    struct stat st;
+    matrix_header_t h;
+    if( m->fd < 0 || fstat( m->fd, &st ) != 0 ) {
+        fprintf( stderr, "Error: Cannot open matrix store `%s'\n", path );
+        matrix_close( m );
+        return NULL;
+    }
+    if( pread( m->fd, &h, sizeof( h ), 0 ) != sizeof( h ) || !matrix_checkHeader( &h, st.st_size ) ) {
+        fprintf( stderr, "Error: `%s' is not a matrix store\n", path );
+        matrix_close( m );
+        return NULL;
+    }
+    m->count = h.count;
+    m->tileSize = h.tileSize;
+    m->symmetric = h.symmetric != 0;
+    if( !matrix_map( m ) ) {
+        fprintf( stderr, "Error: Cannot map matrix store `%s'\n", path );
+        matrix_close( m );
+        return NULL;
+    }
+    return m;
+}
+
+void
+matrix_close( matrix_t* m ) {
+    if( m->map ) {
+        if( m->writable )
+            msync( m->map, m->size, MS_SYNC );
+        munmap( m->map, m->size );
+    }
+    if( m->fd >= 0 )
+        close( m->fd );
+    free( m );
+}
+
+static uint64_t
+matrix_tileIndex( const matrix_t* m, uint64_t ti, uint64_t tj ) {
+    // In a symmetric matrix, row ti of tiles starts after the ti rows above it, which are shorter by one tile each
+    if( m->symmetric )
+        return ti * m->tilesPerRow - (ti * (ti + 1)) / 2 + tj;
+    return ti * m->tilesPerRow + tj;
+}
+
+/*
+ * Returns the values of tile (ti, tj), tileSize rows of tileSize values.
+ * In a symmetric matrix ti must not be larger than tj.
+ * Different tiles can be written from different threads at the same time.
+ */
+double*
+matrix_tile( const matrix_t* m, uint64_t ti, uint64_t tj ) {
+    return m->tiles + matrix_tileIndex( m, ti, tj ) * (uint64_t)m->tileSize * m->tileSize;
+}
+
+bool
+matrix_isDone( const matrix_t* m, uint64_t ti, uint64_t tj ) {
+    return m->done[matrix_tileIndex( m, ti, tj )] != 0;
+}
+
+/*
+ * Mark tile (ti, tj) as written completely, after all its values have been set
+ */
+void
+matrix_setDone( matrix_t* m, uint64_t ti, uint64_t tj ) {
+    m->done[matrix_tileIndex( m, ti, tj )] =1;
+}
+
+bool
+matrix_isComplete( const matrix_t* m ) {
+    for( uint64_t t =0; t < m->tileCount; t++ )
+        if( !m->done[t] )
+            return false;
+    return true;
+}
+
+/*
+ * Returns the value in row i and column j, which is undefined unless its tile is done
+ */
+double
+matrix_get( const matrix_t* m, uint64_t i, uint64_t j ) {
+    if( m->symmetric && i > j ) {
+        uint64_t tmp = i;
+        i = j;
+        j = tmp;
+    }
+    const double* tile = matrix_tile( m, i / m->tileSize, j / m->tileSize );
+    return tile[(i % m->tileSize) * m->tileSize + j % m->tileSize];
+}
+
+void
+matrix_set( matrix_t* m, uint64_t i, uint64_t j, double value ) {
+    if( m->symmetric && i > j ) {
+        uint64_t tmp = i;
+        i = j;
+        j = tmp;
+    }
+    double* tile = matrix_tile( m, i / m->tileSize, j / m->tileSize );
+    tile[(i % m->tileSize) * m->tileSize + j % m->tileSize] = value;
+}
@@ -0,0 +1,76 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+// Binary store of a square matrix of doubles in fixed-size tiles, memory-mapped from a file
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MATRIX_DESCRIPTION_MAX 2048
+
+/* The file starts with this header, followed by one flag per tile that is set once the tile
+ * has been written completely, followed by the tiles themselves. Each tile holds tileSize rows of
+ * tileSize values, in row order. In a symmetric matrix only tiles on and above the diagonal are stored.
+ * Values are stored in the byte order of the machine that wrote them.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t tileSize;
+    uint64_t count;                 // number of rows and columns
+    uint32_t symmetric;
+    uint32_t reserved;
+    uint64_t tileCount;
+    char description[MATRIX_DESCRIPTION_MAX]; // of what the matrix holds, to check that a store is resumed correctly
+} matrix_header_t;
+
+typedef struct {
+    int fd;
+    uint8_t* map;
+    size_t size;
+    const matrix_header_t* header;
+    uint8_t* done;                  // one flag per tile
+    double* tiles;
+    uint64_t count;
+    int tileSize;
+    uint64_t tilesPerRow, tileCount;
+    bool symmetric;
+    bool writable;
+} matrix_t;
+
+matrix_t*
+matrix_create( const char* path, uint64_t count, int tileSize, bool symmetric, const char* description );
+
+matrix_t*
+matrix_open( const char* path );
+
+void
+matrix_close( matrix_t* m );
+
+double*
+matrix_tile( const matrix_t* m, uint64_t ti, uint64_t tj );
+
+bool
+matrix_isDone( const matrix_t* m, uint64_t ti, uint64_t tj );
+
+void
+matrix_setDone( matrix_t* m, uint64_t ti, uint64_t tj );
+
+bool
+matrix_isComplete( const matrix_t* m );
+
+double
+matrix_get( const matrix_t* m, uint64_t i, uint64_t j );
+
+void
+matrix_set( matrix_t* m, uint64_t i, uint64_t j, double value );
+
+#endif
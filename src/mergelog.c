@@ -0,0 +1,159 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // ftruncate(), fileno()
+
+#include "mergelog.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void
+mergelog_add( mergelog_t* log, const mergelog_entry_t* entry ) {
+    if( log->count == log->capacity ) {
+        log->capacity = log->capacity ? log->capacity * 2 : 256;
+        log->entries = (mergelog_entry_t*)realloc( log->entries, sizeof( mergelog_entry_t ) * log->capacity );
+    }
+    log->entries[log->count++] = *entry;
+}
+
+/*
+ * Read the header and all merges from f, up to the first line that is incomplete or malformed,
+ * which can only be the last line that was being written when a run was killed.
+ * Returns false if the file does not start with a header.
+ * If valid is given, it is set to the number of bytes of f up to and including the last line that was read.
+ */
+static bool
+mergelog_load( mergelog_t* log, FILE* f, long* valid ) {
+    char line[MERGELOG_HEADER_MAX];
+
+    log->header[0] ='\0';
+    if( !fgets( log->header, sizeof( log->header ), f ) || !strchr( log->header, '\n' ) )
+        return false;
+    log->header[strcspn( log->header, "\n" )] ='\0';
+    long end = ftell( f );
+
+    while( !log->finished && fgets( line, sizeof( line ), f ) ) {
+        mergelog_entry_t e;
+        if( !strchr( line, '\n' ) )
+            break;
+        if( strcmp( line, "end\n" ) == 0 )
+            log->finished =true;
+        else if( sscanf( line, "%d %d %d %d %d %d", &e.p1, &e.p2, &e.row, &e.col, &e.variant, &e.created ) == 6 )
+            mergelog_add( log, &e );
+        else
+            break;
+        end = ftell( f );
+    }
+    if( valid )
+        *valid =end;
+    return true;
+}
+
+static mergelog_t*
+mergelog_alloc( void ) {
+    mergelog_t* log = (mergelog_t*)calloc( 1, sizeof( mergelog_t ) );
+    return log;
+}
+
+/*
+ * Open a log file for appending. If the file already holds merges, its header must equal
+ * the given header and the merges are read into log->entries, so they can be replayed with vouw_replay().
+ * A line that was cut off is removed from the file.
+ * Returns NULL and prints an error message if the file cannot be used.
+ */
+mergelog_t*
+mergelog_open( const char* path, const char* header ) {
+    mergelog_t* log = mergelog_alloc();
+
+    log->file = fopen( path, "r+" );
+    if( log->file ) {
+        long valid =0;
+        if( !mergelog_load( log, log->file, &valid ) ) {
+            // Not even the header was written, start over
+            log->count =0;
+            log->header[0] ='\0';
+            valid =0;
+        } else if( strcmp( log->header, header ) != 0 ) {
+            fprintf( stderr, "Error: Merge log `%s' was written for a different automaton:\n%s\n", path, log->header );
+            mergelog_close( log );
+            return NULL;
+        }
+        if( ftruncate( fileno( log->file ), valid ) != 0 || fseek( log->file, valid, SEEK_SET ) != 0 ) {
+            fprintf( stderr, "Error: Cannot write merge log `%s'\n", path );
+            mergelog_close( log );
+            return NULL;
+        }
+    } else
+        log->file = fopen( path, "w" );
+    if( !log->file ) {
+        fprintf( stderr, "Error: Cannot open merge log `%s'\n", path );
+        mergelog_close( log );
+        return NULL;
+    }
+    if( log->header[0] == '\0' ) {
+        strncpy( log->header, header, sizeof( log->header ) -1 );
+        fprintf( log->file, "%s\n", header );
+    }
+    fflush( log->file );
+    return log;
+}
+
+/*
+ * Read all merges from a log file, returns NULL if it cannot be read
+ */
+mergelog_t*
+mergelog_read( const char* path ) {
+    FILE* f = fopen( path, "r" );
+    if( !f ) {
+        fprintf( stderr, "Error: Cannot open merge log `%s'\n", path );
+        return NULL;
+    }
+    mergelog_t* log = mergelog_alloc();
+    bool ok = mergelog_load( log, f, NULL );
+    fclose( f );
+    if( !ok ) {
+        fprintf( stderr, "Error: `%s' is not a merge log\n", path );
+        mergelog_close( log );
+        return NULL;
+    }
+    return log;
+}
+
+/*
+ * Add a merge to the log and flush it to the file, so that a killed encoding can be resumed from it
+ */
+void
+mergelog_append( mergelog_t* log, const mergelog_entry_t* entry ) {
+    mergelog_add( log, entry );
+    if( !log->file )
+        return;
+    fprintf( log->file, "%d %d %d %d %d %d\n", entry->p1, entry->p2, entry->row, entry->col, entry->variant, entry->created );
+    fflush( log->file );
+}
+
+/*
+ * Mark the encoding as finished: no merge with a gain remains after the last one
+ */
+void
+mergelog_finish( mergelog_t* log ) {
+    if( log->finished )
+        return;
+    log->finished =true;
+    if( !log->file )
+        return;
+    fprintf( log->file, "end\n" );
+    fflush( log->file );
+}
+
+void
+mergelog_close( mergelog_t* log ) {
+    if( log->file )
+        fclose( log->file );
+    free( log->entries );
+    free( log );
+}
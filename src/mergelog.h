@@ -0,0 +1,57 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef MERGELOG_H
+#define MERGELOG_H
+
+// Append-only log of the merges made by vouw_encode(), so that an encoding can be replayed or resumed
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MERGELOG_HEADER_MAX 2048
+
+/* One merge of vouw_encodeStep(). Patterns are identified by their index in the code table
+ * (see pattern_list_setIndices()): p1 and p2 before the merge, created after it. */
+typedef struct {
+    int p1;
+    int p2;
+    int row;            // offset of p2's pivot from p1's pivot
+    int col;
+    int variant;
+    int created;        // index of the union of p1 and p2
+} mergelog_entry_t;
+
+/* The first line of a log file describes the automaton, every other line holds one merge
+ * as `p1 p2 row col variant created'. The line `end' follows the last merge of a finished encoding.
+ */
+typedef struct {
+    FILE* file;         // NULL if opened with mergelog_read()
+    char header[MERGELOG_HEADER_MAX];
+    mergelog_entry_t* entries;
+    uint64_t count;
+    uint64_t capacity;
+    bool finished;
+} mergelog_t;
+
+mergelog_t*
+mergelog_open( const char* path, const char* header );
+
+mergelog_t*
+mergelog_read( const char* path );
+
+void
+mergelog_append( mergelog_t* log, const mergelog_entry_t* entry );
+
+void
+mergelog_finish( mergelog_t* log );
+
+void
+mergelog_close( mergelog_t* log );
+
+#endif
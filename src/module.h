@@ -12,7 +12,7 @@
 #include "rfca.h"
 
 // We use a simple array to hold module structures
-#define MAX_MODULES 16
+#define MAX_MODULES 32
 
 typedef int (*module_func_t) ( rfca_opts_t, int argc, char** argv );
 
@@ -5,6 +5,8 @@
  * Leiden Institute for Advanced Computer Science
  */
 
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+
 #include "module_batch.h"
 #include "vouw.h"
 #include "list.h"
@@ -13,21 +15,501 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "cli.h"
+#include "sched.h"
+#include "checkpoint.h"
+#include "symmetry.h"
+#include "dedupe.h"
+#include "cache.h"
+#include "pipeline.h"
+#include "results.h"
+
+// Number of rules that may be in flight ahead of the first rule that has not been printed
+#define REORDER_WINDOW 65536
+// Capacity of each queue between the stages of encode-all
+#define ENCODEALL_QUEUE 256
+
+/* One rule on its way through the stages of encode-all */
+typedef struct {
+    uint64_t rule;
+    uint64_t canonical;         // equivalent rule whose result is used if derived is set
+    bool derived;
+    bool stored;                // set once the result is in the checkpoint
+    rfca_t* rfca;               // generated automaton, until it has been encoded
+    dedupe_entry_t* entry;      // where the result is published for rules with the same automaton
+    cache_self_t self;
+    bool haveSelf;              // set if self was found in the cache
+    bool knowSelf;              // set if self is filled in, from the cache or by encoding
+    int patterns;               // size of the code table if self-encoded, or -1
+    double compressed_using;
+    bool haveCross;
+    double value;
+    double seconds;             // time spent encoding
+} encodeall_item_t;
+
+typedef struct {
+    rfca_opts_t opts;
+    const vouw_t* using;
+    rfca_opts_t usingOpts;
+    vouw_scratch_t** scratch;   // one per cross-encoding worker
+    vouw_t** encoders;          // one per self-encoding worker, reused for every rule
+    vouw_target_t** targets;    // one per cross-encoding worker, reused for every rule
+    pipeline_pool_t items;      // items and automata that can be used again
+    pipeline_pool_t automata;
+    checkpoint_t* checkpoint;   // optional
+    results_writer_t* results;  // optional, written instead of the text output
+    dedupe_t* dedupe;           // optional, results of the automata encoded so far
+    cache_t* cache;             // optional, results of earlier runs
+    uint64_t first, count;      // the range of rules that is encoded
+
+    // generate -> self-encode -> cross-encode -> write, every stage can also pass rules to the writer
+    pipeline_queue_t toEncode, toCross, toWrite;
+    pthread_mutex_t lock;       // protects next and printed
+    pthread_cond_t advanced;    // signalled when printed increases
+    uint64_t next;              // the number of rules taken by the generate stage
+    uint64_t printed;           // the number of rules printed so far
+    uint64_t received;          // the number of rules that reached the writer
+    uint64_t progress;          // in tenths of a percent, as shown on the progress line
+    encodeall_item_t** pending; // rules that reached the writer, indexed by rule modulo REORDER_WINDOW
+
+    symmetry_group_t group;     // value maps under which results are invariant
+    uint64_t* keptRules;        // results of printed rules that are encoded, in rule order
+    results_record_t* keptRecords;
+    uint64_t kept, keptCapacity;
+} encodeall_ctx_t;
+
+/*
+ * Compute the printed result from the self-encoding of a rule and, with `using', its cross-encoded length
+ */
+static double
+encodeAll_value( const encodeall_ctx_t* ctx, const cache_self_t* self, double compressed_using ) {
+    if( ctx->using )
+        return (compressed_using - self->compressed) / self->compressed /** 100.0*/;
+    return self->compressed / self->uncompressed * 100.0;
+}
+
+static double
+encodeAll_now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void
+encodeAll_freeAutomaton( void* r ) {
+    rfca_free( (rfca_t*)r );
+}
+
+/*
+ * Pass a rule whose result is known to the writer
+ */
+static void
+encodeAll_done( encodeall_ctx_t* ctx, encodeall_item_t* item ) {
+    if( ctx->checkpoint && !item->stored ) {
+        checkpoint_append( ctx->checkpoint, item->rule, item->value );
+        item->stored =true;
+    }
+    pipeline_queue_push( &ctx->toWrite, item );
+}
 
+/*
+ * Compute the result of a rule that has been self-encoded and cross-encoded,
+ * share it with rules that generate the same automaton and pass it on to the writer
+ */
+static void
+encodeAll_finish( encodeall_ctx_t* ctx, encodeall_item_t* item ) {
+    item->value = encodeAll_value( ctx, &item->self, item->compressed_using );
+    if( item->entry )
+        dedupe_publish( ctx->dedupe, item->entry, item->value );
+    pipeline_pool_give( &ctx->automata, item->rfca );
+    item->rfca =NULL;
+    encodeAll_done( ctx, item );
+}
+
+/*
+ * Generate stage: take rules in order and generate those that are not known yet
+ */
+static void
+encodeAll_generate( void* arg, int worker ) {
+    (void)worker;
+    encodeall_ctx_t* ctx = (encodeall_ctx_t*)arg;
+
+    for( ;; ) {
+        // Stay within REORDER_WINDOW rules of the first rule that is not printed
+        pthread_mutex_lock( &ctx->lock );
+        while( ctx->next < ctx->count && ctx->next >= ctx->printed + REORDER_WINDOW )
+            pthread_cond_wait( &ctx->advanced, &ctx->lock );
+        const uint64_t k = ctx->next;
+        if( k < ctx->count )
+            ctx->next++;
+        pthread_mutex_unlock( &ctx->lock );
+        if( k >= ctx->count )
+            break;
+
+        encodeall_item_t* item = (encodeall_item_t*)pipeline_pool_take( &ctx->items );
+        if( !item )
+            item = (encodeall_item_t*)malloc( sizeof( encodeall_item_t ) );
+        item->rule = ctx->first + k;
+        item->canonical = item->rule;
+        item->derived =false;
+        item->stored =false;
+        item->rfca =NULL;
+        item->entry =NULL;
+        item->knowSelf =false;
+        item->patterns =-1;
+        item->compressed_using =0.0;
+        item->seconds =0.0;
+
+        // Results from a checkpoint are passed on as they are
+        if( ctx->checkpoint && checkpoint_find( ctx->checkpoint, item->rule, &item->value ) ) {
+            item->stored =true;
+            pipeline_queue_push( &ctx->toWrite, item );
+            continue;
+        }
+
+        // Equivalent rules are not encoded again, their result is filled in by the writer
+        int map;
+        item->canonical = symmetry_canonical( &ctx->group, item->rule, ctx->first, &map );
+        if( item->canonical != item->rule ) {
+            item->derived =true;
+            pipeline_queue_push( &ctx->toWrite, item );
+            continue;
+        }
+
+        // Results of earlier runs are taken from the cache without generating the automaton
+        rfca_opts_t opts = ctx->opts;
+        opts.rule = item->rule;
+        item->haveSelf = ctx->cache && cache_findSelf( ctx->cache, &opts, &item->self );
+        item->knowSelf = item->haveSelf;
+        item->haveCross = !ctx->using ||
+            (ctx->cache && cache_findCross( ctx->cache, &ctx->usingOpts, &opts, &item->compressed_using ));
+        if( item->haveSelf && item->haveCross ) {
+            item->value = encodeAll_value( ctx, &item->self, item->compressed_using );
+            encodeAll_done( ctx, item );
+            continue;
+        }
+
+        // Automata of rules that have been encoded are generated again for the next rule
+        item->rfca = (rfca_t*)pipeline_pool_take( &ctx->automata );
+        if( item->rfca )
+            rfca_reset( item->rfca, item->rule );
+        else
+            item->rfca = rfca_create( opts );
+        rfca_generate( item->rfca );
+        pipeline_queue_push( &ctx->toEncode, item );
+    }
+    pipeline_queue_close( &ctx->toEncode );
+    pipeline_queue_close( &ctx->toWrite );
+}
+
+/*
+ * Self-encode stage: encode each automaton with its own code table, unless an identical automaton was encoded before
+ */
+static void
+encodeAll_selfEncode( void* arg, int worker ) {
+    encodeall_ctx_t* ctx = (encodeall_ctx_t*)arg;
+    encodeall_item_t* item;
+
+    while( (item = (encodeall_item_t*)pipeline_queue_pop( &ctx->toEncode )) ) {
+        // Rules that generate the same automaton have the same result
+        bool found =false;
+        dedupe_entry_t* e = ctx->dedupe ? dedupe_acquire( ctx->dedupe, item->rfca, item->rule, &found ) : NULL;
+        if( found ) {
+            item->value = e->value;
+            if( ctx->cache ) {
+                // The results of the first rule were stored before they were published
+                rfca_opts_t same = item->rfca->opts;
+                same.rule = e->rule;
+                if( !item->haveSelf && cache_findSelf( ctx->cache, &same, &item->self ) ) {
+                    cache_storeSelf( ctx->cache, &item->rfca->opts, &item->self );
+                    item->knowSelf =true;
+                }
+                if( !item->haveCross && cache_findCross( ctx->cache, &ctx->usingOpts, &same, &item->compressed_using ) )
+                    cache_storeCross( ctx->cache, &ctx->usingOpts, &item->rfca->opts, item->compressed_using );
+            }
+            pipeline_pool_give( &ctx->automata, item->rfca );
+            item->rfca =NULL;
+            encodeAll_done( ctx, item );
+            continue;
+        }
+        item->entry = e;
+
+        if( !item->haveSelf ) {
+            const double start = encodeAll_now();
+            vouw_t* v = ctx->encoders[worker];
+            if( v )
+                vouw_reset( v, item->rfca );
+            else {
+                v = ctx->encoders[worker] = vouw_createFrom( item->rfca );
+                v->keepBuffer =true;
+            }
+            item->self.uncompressed = v->ctBits + v->encodedBits;
+            item->self.steps = vouw_encode( v );
+            item->self.compressed = v->ctBits + v->encodedBits;
+            item->self.digest = pattern_list_digest( v->codeTable );
+            item->knowSelf =true;
+            item->patterns =0;
+            struct list_head* pos;
+            list_for_each( pos, &(v->codeTable->list) )
+                item->patterns++;
+            if( ctx->cache )
+                cache_storeSelf( ctx->cache, &item->rfca->opts, &item->self );
+            item->seconds += encodeAll_now() - start;
+        }
+
+        if( item->haveCross )
+            encodeAll_finish( ctx, item );
+        else
+            pipeline_queue_push( &ctx->toCross, item );
+    }
+    pipeline_queue_close( &ctx->toCross );
+    pipeline_queue_close( &ctx->toWrite );
+}
+
+/*
+ * Cross-encode stage: encode each automaton with the code table of `using'
+ */
+static void
+encodeAll_crossEncode( void* arg, int worker ) {
+    encodeall_ctx_t* ctx = (encodeall_ctx_t*)arg;
+    encodeall_item_t* item;
+
+    while( (item = (encodeall_item_t*)pipeline_queue_pop( &ctx->toCross )) ) {
+        // Only the length is needed, so we don't build the encoded representation
+        const double start = encodeAll_now();
+        vouw_target_t* t = ctx->targets[worker];
+        if( t )
+            vouw_target_reset( t, item->rfca );
+        else
+            t = ctx->targets[worker] = vouw_target_create( item->rfca );
+        item->compressed_using = vouw_crossEncodedLength( t, ctx->using->codeTable, ctx->scratch[worker], NULL, NULL );
+        if( ctx->cache )
+            cache_storeCross( ctx->cache, &ctx->usingOpts, &item->rfca->opts, item->compressed_using );
+        item->seconds += encodeAll_now() - start;
+        encodeAll_finish( ctx, item );
+    }
+    pipeline_queue_close( &ctx->toWrite );
+}
+
+/*
+ * Returns the result of a rule that has already been printed and encoded
+ */
+static const results_record_t*
+encodeAll_printedRecord( const encodeall_ctx_t* ctx, uint64_t rule ) {
+    uint64_t lo =0, hi = ctx->kept;
+    while( lo < hi ) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if( ctx->keptRules[mid] < rule )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return &ctx->keptRecords[lo];
+}
+
+/*
+ * Fill in the record of a rule from what is known about it
+ */
+static void
+encodeAll_record( results_record_t* r, const encodeall_item_t* item ) {
+    results_record_init( r, item->rule, item->value );
+    if( item->knowSelf ) {
+        r->uncompressed = item->self.uncompressed;
+        r->compressed = item->self.compressed;
+        r->steps = item->self.steps;
+    }
+    r->patterns = item->patterns;
+    r->seconds = item->seconds;
+}
+
+/*
+ * Write stage: print all results in rule order and update the progress line
+ */
+static void
+encodeAll_write( void* arg, int worker ) {
+    (void)worker;
+    encodeall_ctx_t* ctx = (encodeall_ctx_t*)arg;
+    encodeall_item_t* item;
+
+    while( (item = (encodeall_item_t*)pipeline_queue_pop( &ctx->toWrite )) ) {
+        ctx->pending[(item->rule - ctx->first) % REORDER_WINDOW] = item;
+        ctx->received++;
+
+        uint64_t printed = ctx->printed;
+        while( printed < ctx->count && (item = ctx->pending[printed % REORDER_WINDOW]) ) {
+            ctx->pending[printed % REORDER_WINDOW] =NULL;
+            results_record_t record;
+            if( item->derived ) {
+                // The canonical rule is smaller and hence printed already
+                record = *encodeAll_printedRecord( ctx, item->canonical );
+                record.rule = item->rule;
+                record.seconds =0.0;
+                item->value = record.value;
+                if( ctx->checkpoint )
+                    checkpoint_append( ctx->checkpoint, item->rule, item->value );
+            } else {
+                encodeAll_record( &record, item );
+                if( ctx->group.count > 1 ) {
+                    // Keep the result for equivalent rules that come later
+                    if( ctx->kept == ctx->keptCapacity ) {
+                        ctx->keptCapacity = ctx->keptCapacity ? ctx->keptCapacity * 2 : 1024;
+                        ctx->keptRules = (uint64_t*)realloc( ctx->keptRules, sizeof( uint64_t ) * ctx->keptCapacity );
+                        ctx->keptRecords = (results_record_t*)realloc( ctx->keptRecords, sizeof( results_record_t ) * ctx->keptCapacity );
+                    }
+                    ctx->keptRules[ctx->kept] = item->rule;
+                    ctx->keptRecords[ctx->kept++] = record;
+                }
+            }
+
+            if( ctx->results )
+                results_writer_append( ctx->results, &record );
+            else if( ctx->using )
+                printf( "\t%f", item->value );
+            else
+                printf( "%"PRIu64" %f%%\n", item->rule, item->value );
+            pipeline_pool_give( &ctx->items, item );
+            printed++;
+        }
+
+        if( printed != ctx->printed ) {
+            pthread_mutex_lock( &ctx->lock );
+            ctx->printed = printed;
+            pthread_cond_broadcast( &ctx->advanced );
+            pthread_mutex_unlock( &ctx->lock );
+        }
+        // The progress line is only updated when the shown percentage changes
+        const uint64_t progress = ctx->received * 1000 / ctx->count;
+        if( progress != ctx->progress || ctx->received == ctx->count ) {
+            ctx->progress = progress;
+            fprintf( stderr, "\rEncoded %"PRIu64" of %"PRIu64" rules (%.1f%%)", 
+                ctx->received, ctx->count, (double)ctx->received/(double)ctx->count * 100.0 );
+        }
+    }
+}
+
+/*
+ * Describe a run of encode-all in the header of its checkpoint file,
+ * so results are only resumed or merged with results of the same configuration.
+ * The rule of opts is not part of the description.
+ */
+static void
+encodeAll_header( char* buf, size_t size, rfca_opts_t opts, const rfca_opts_t* using ) {
+    opts.rule =0;
+    int n = snprintf( buf, size, "vouw encode-all " );
+    n += cli_formatOpts( buf + n, size - n, &opts );
+    if( using && n < (int)size ) {
+        n += snprintf( buf + n, size - n, " using " );
+        cli_formatOpts( buf + n, size - n, using );
+    } else if( n < (int)size )
+        snprintf( buf + n, size - n, " using none" );
+}
+
+/*
+ * Parse a shard specification `k/N' and compute the k-th of N consecutive ranges of rules
+ */
+static bool
+parseShard( const char* spec, uint64_t rulespace, uint64_t* first, uint64_t* last ) {
+    uint64_t k, n;
+    if( sscanf( spec, "%"SCNu64"/%"SCNu64, &k, &n ) != 2 || n == 0 || k >= n )
+        return false;
+    const uint64_t end = (uint64_t)((double)rulespace * (k+1) / n);
+    *first = (uint64_t)((double)rulespace * k / n);
+    if( end <= *first )
+        return false;
+    *last = end -1;
+    return true;
+}
 
 int module_encodeAll( rfca_opts_t opts, int argc, char** argv ) {
     uint64_t rulespace = rfca_maxRules( opts.base, opts.mode );
+    int threads =1, generateThreads =1, crossThreads =0;
+    int rc;
+    uint64_t first =0, last = rulespace -1;
+    const char* checkpointPath =NULL;
+    const char* cachePath =NULL;
+    bool symmetry =true;
+    bool dedupe =true;
+    bool binary =false;
     
     rfca_opts_t opts2 = opts;
     vouw_t* using = NULL;
-    double using_baseline =0.0;
+
+    if( !cli_checkGenerated( &opts ) )
+        return -1;
+
+    // Options of this module come before `using'
+    while( argc > 0 ) {
+        if( (rc = sched_parseThreads( &threads, &argv, &argc )) < 0 ) {
+            fprintf( stderr, "Error: Parameter `threads' requires a positive number\n" );
+            return -1;
+        } else if( rc > 0 ) 
+            continue;
+
+        if( strcmp( argv[0], "--shard" ) == 0 && argc > 1 ) {
+            if( !parseShard( argv[1], rulespace, &first, &last ) ) {
+                fprintf( stderr, "Error: Parameter `shard' must be given as k/N with k < N and N at most the number of rules\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--range" ) == 0 && argc > 1 ) {
+            if( sscanf( argv[1], "%"SCNu64"-%"SCNu64, &first, &last ) != 2 || first > last || last >= rulespace ) {
+                fprintf( stderr, "Error: Parameter `range' must be given as FIRST-LAST, with LAST < %"PRIu64"\n", rulespace );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--checkpoint" ) == 0 && argc > 1 ) {
+            checkpointPath = argv[1];
+        } else if( strcmp( argv[0], "--cache" ) == 0 && argc > 1 ) {
+            cachePath = argv[1];
+        } else if( strcmp( argv[0], "--output-format" ) == 0 && argc > 1 ) {
+            if( strcmp( argv[1], "bin" ) == 0 )
+                binary =true;
+            else if( strcmp( argv[1], "text" ) == 0 )
+                binary =false;
+            else {
+                fprintf( stderr, "Error: Parameter `output-format' must be text or bin\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--generate-threads" ) == 0 && argc > 1 ) {
+            if( (generateThreads = atoi( argv[1] )) < 1 ) {
+                fprintf( stderr, "Error: Parameter `generate-threads' requires a positive number\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--cross-threads" ) == 0 && argc > 1 ) {
+            if( (crossThreads = atoi( argv[1] )) < 1 ) {
+                fprintf( stderr, "Error: Parameter `cross-threads' requires a positive number\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--no-symmetry" ) == 0 ) {
+            symmetry =false;
+            argv++; argc--;
+            continue;
+        } else if( strcmp( argv[0], "--no-dedupe" ) == 0 ) {
+            dedupe =false;
+            argv++; argc--;
+            continue;
+        } else
+            break;
+        argv += 2; argc -= 2;
+    }
+
+    // The cross-encode stage has as many workers as the self-encode stage unless given otherwise
+    if( !crossThreads )
+        crossThreads =threads;
+    vouw_scratch_t* scratch[crossThreads];
+    vouw_target_t* targets[crossThreads];
+    for( int i =0; i < crossThreads; i++ ) {
+        scratch[i] = vouw_scratch_create();
+        targets[i] =NULL;
+    }
+    vouw_t* encoders[threads];
+    for( int i =0; i < threads; i++ )
+        encoders[i] =NULL;
 
     if( argc > 0 && strcmp( argv[0], "using" ) == 0 ) {
 
         rfca_t* r2 = NULL;
         argv++; argc--;
-        if( !cli_parseOpts( &opts2, &argv, &argc ) ) {
+        if( !cli_parseOpts( &opts2, &argv, &argc ) || !cli_checkGenerated( &opts2 ) ) {
             return -1;
         }
         r2 = rfca_create( opts2 );
@@ -35,56 +517,279 @@ int module_encodeAll( rfca_opts_t opts, int argc, char** argv ) {
         using = vouw_createFrom( r2 );
         vouw_encode( using );
 
-        // Create a baseline by compressing this rule by its own code table
-        vouw_t* v2 =vouw_createEncodedUsing( r2, using->codeTable );
-        using_baseline = v2->ctBits + v2->encodedBits;
-        vouw_free( v2 );
-
         rfca_free( r2 );
         fprintf( stderr, "Now encoding RFCA class: %d.%d for %"PRIu64" rules, using RFCA: %d.%d.%"PRIu64"\n",
             opts.mode, opts.base, rulespace,
             opts2.mode, opts2.base, opts2.rule);
-        if( opts2.rule == 0 ) {
+        if( opts2.rule == 0 && !binary ) {
             printf( "%"PRIu64"", rulespace );
             for( uint64_t i=0; i < rulespace; i++ )
                 printf( "\t%"PRIu64"", i );
-            printf( "\n", opts2.rule );
+            printf( "\n" );
         }
-        printf( "%d", opts2.rule );
+        if( !binary )
+            printf( "%"PRIu64, opts2.rule );
 
     } 
     else
         fprintf( stderr, "Now encoding RFCA class: %d.%d for %"PRIu64" rules\n",
             opts.mode, opts.base, rulespace );
 
-    for( uint64_t i=0; i < rulespace; i++ ) {
-        opts.rule = i;
-        rfca_t* r =rfca_create( opts );
-        rfca_generate( r );
-
-        fprintf( stderr, "Encoding %"PRIu64" (%.1f%%)...", i, (double)i/(double)rulespace * 100.0 );
-
-        vouw_t* v =vouw_createFrom( r );
-        double uncompressed = v->ctBits + v->encodedBits;
-        vouw_encode( v );
-        double compressed = v->ctBits + v->encodedBits;
-        double compressed_using =compressed;
-        
-        if( using ) {
-            vouw_free( v );
-            v = vouw_createEncodedUsing( r, using->codeTable );
-            compressed_using = v->ctBits + v->encodedBits;
-        }
-        
-        fprintf( stderr, "done.\n" );
-        if( using )
-            printf( "\t%f", (compressed_using - compressed) / compressed /** 100.0*/ );
-        else
-            printf( "%"PRIu64" %f%%\n", i, compressed_using / uncompressed * 100.0 );
-        
+    // Rules pass through a pipeline of stages and are printed in order as they complete
+    encodeall_ctx_t ctx;
+    ctx.opts =opts;
+    ctx.using =using;
+    ctx.usingOpts =opts2;
+    ctx.scratch =scratch;
+    ctx.encoders =encoders;
+    ctx.targets =targets;
+    pipeline_pool_init( &ctx.items );
+    pipeline_pool_init( &ctx.automata );
+    ctx.first =first;
+    ctx.count =last - first + 1;
+    ctx.checkpoint =NULL;
+    ctx.results =NULL;
+    ctx.dedupe = dedupe ? dedupe_create() : NULL;
+    ctx.cache =NULL;
+    ctx.next =0;
+    ctx.printed =0;
+    ctx.received =0;
+    ctx.progress =0;
+    ctx.pending = (encodeall_item_t**)calloc( REORDER_WINDOW, sizeof( encodeall_item_t* ) );
+    ctx.keptRules =NULL;
+    ctx.keptRecords =NULL;
+    ctx.kept =ctx.keptCapacity =0;
+
+    // Only value maps that also leave the `using' automaton unchanged preserve the results
+    symmetry_group_init( &ctx.group, &opts );
+    if( using )
+        symmetry_group_stabilize( &ctx.group, &opts2 );
+    if( !symmetry )
+        ctx.group.count =1;
+    if( ctx.group.count > 1 )
+        fprintf( stderr, "Encoding one rule out of each class of up to %d equivalent rules\n", ctx.group.count );
+
+    if( cachePath ) {
+        ctx.cache = cache_open( cachePath );
+        if( !ctx.cache )
+            return -1;
+    }
+    if( checkpointPath ) {
+        char header[CHECKPOINT_HEADER_MAX];
+        encodeAll_header( header, sizeof( header ), opts, using ? &opts2 : NULL );
+        ctx.checkpoint = checkpoint_open( checkpointPath, header );
+        if( !ctx.checkpoint )
+            return -1;
+        if( ctx.checkpoint->count )
+            fprintf( stderr, "Resuming from %"PRIu64" results in `%s'\n", ctx.checkpoint->count, checkpointPath );
+    }
+    if( binary ) {
+        char description[RESULTS_DESCRIPTION_MAX];
+        encodeAll_header( description, sizeof( description ), opts, using ? &opts2 : NULL );
+        results_header_t h;
+        results_header_init( &h, rulespace, using ? (int64_t)opts2.rule : -1, description );
+        ctx.results = results_writer_open( stdout, &h );
+    }
+
+    // Without `using' there is nothing to cross-encode
+    const int crossWorkers = using ? crossThreads : 0;
+    const pipeline_stage_t stages[] = {
+        { encodeAll_generate, generateThreads },
+        { encodeAll_selfEncode, threads },
+        { encodeAll_crossEncode, crossWorkers },
+        { encodeAll_write, 1 } };
+    pipeline_queue_init( &ctx.toEncode, ENCODEALL_QUEUE, generateThreads );
+    pipeline_queue_init( &ctx.toCross, ENCODEALL_QUEUE, threads );
+    pipeline_queue_init( &ctx.toWrite, ENCODEALL_QUEUE, generateThreads + threads + crossWorkers );
+    pthread_mutex_init( &ctx.lock, NULL );
+    pthread_cond_init( &ctx.advanced, NULL );
+
+    pipeline_run( stages, 4, &ctx );
+
+    pipeline_queue_destroy( &ctx.toEncode );
+    pipeline_queue_destroy( &ctx.toCross );
+    pipeline_queue_destroy( &ctx.toWrite );
+    pthread_mutex_destroy( &ctx.lock );
+    pthread_cond_destroy( &ctx.advanced );
+    fprintf( stderr, "\n" );
+    if( ctx.results )
+        results_writer_close( ctx.results );
+    else
+        printf( "\n" );
+
+    if( ctx.dedupe ) {
+        if( ctx.dedupe->lookups )
+            dedupe_printStats( ctx.dedupe, stderr );
+        dedupe_free( ctx.dedupe );
+    }
+    if( ctx.cache ) {
+        cache_printStats( ctx.cache, stderr );
+        cache_close( ctx.cache );
+    }
+    if( ctx.checkpoint )
+        checkpoint_close( ctx.checkpoint );
+    free( ctx.pending );
+    free( ctx.keptRules );
+    free( ctx.keptRecords );
+    for( int i =0; i < crossThreads; i++ ) {
+        vouw_scratch_free( scratch[i] );
+        if( targets[i] )
+            vouw_target_free( targets[i] );
+    }
+    for( int i =0; i < threads; i++ )
+        if( encoders[i] )
+            vouw_free( encoders[i] );
+    pipeline_pool_destroy( &ctx.items, free );
+    pipeline_pool_destroy( &ctx.automata, encodeAll_freeAutomaton );
+    if( using )
+        vouw_free( using );
+    return 0;
+}
+
+/*
+ * Combine the checkpoint files of one or more encode-all runs, for instance of different shards,
+ * and print the results in the same format as a single run over the entire rulespace.
+ */
+int
+module_mergeCheckpoints( rfca_opts_t opts, int argc, char** argv ) {
+    (void)opts;
+    if( argc < 1 ) {
+        fprintf( stderr, "Error: No checkpoint files given\n" );
+        return -1;
+    }
+
+    checkpoint_t* cp = checkpoint_read( argv[0] );
+    if( !cp )
+        return -1;
+    char header[CHECKPOINT_HEADER_MAX];
+    strcpy( header, cp->header );
+    checkpoint_close( cp );
+
+    int mode, base;
+    uint64_t using_rule =0;
+    const char* using = strstr( header, " using " );
+    if( sscanf( header, "vouw encode-all %d.%d", &mode, &base ) != 2 || !using ||
+        (strcmp( using, " using none" ) != 0 && sscanf( using, " using %*d.%*d.%"SCNu64, &using_rule ) != 1) ) {
+        fprintf( stderr, "Error: `%s' does not contain results of encode-all\n", argv[0] );
+        return -1;
+    }
+    const bool isUsing = strcmp( using, " using none" ) != 0;
+    const uint64_t rulespace = rfca_maxRules( base, mode );
+
+    double* values = (double*)malloc( sizeof( double ) * rulespace );
+    bool* found = (bool*)calloc( rulespace, sizeof( bool ) );
+    int retval =0;
 
-        vouw_free( v );
-        rfca_free( r );
+    for( int f =0; f < argc && retval == 0; f++ ) {
+        cp = checkpoint_read( argv[f] );
+        if( !cp ) {
+            retval =-1;
+            break;
+        }
+        if( strcmp( cp->header, header ) != 0 ) {
+            fprintf( stderr, "Error: `%s' was written by a different run than `%s'\n", argv[f], argv[0] );
+            retval =-1;
+        }
+        for( uint64_t i =0; i < cp->count && retval == 0; i++ ) {
+            if( cp->rules[i] >= rulespace )
+                continue;
+            values[cp->rules[i]] = cp->values[i];
+            found[cp->rules[i]] =true;
+        }
+        checkpoint_close( cp );
     }
-    printf( "\n" );
+
+    for( uint64_t i =0; i < rulespace && retval == 0; i++ ) {
+        if( !found[i] ) {
+            fprintf( stderr, "Error: No result for rule %"PRIu64" in the given checkpoint files\n", i );
+            retval =-1;
+        }
+    }
+
+    if( retval == 0 ) {
+        if( isUsing ) {
+            if( using_rule == 0 ) {
+                printf( "%"PRIu64"", rulespace );
+                for( uint64_t i=0; i < rulespace; i++ )
+                    printf( "\t%"PRIu64"", i );
+                printf( "\n" );
+            }
+            printf( "%d", (int)using_rule );
+            for( uint64_t i=0; i < rulespace; i++ )
+                printf( "\t%f", values[i] );
+        } else {
+            for( uint64_t i=0; i < rulespace; i++ )
+                printf( "%"PRIu64" %f%%\n", i, values[i] );
+        }
+        printf( "\n" );
+    }
+
+    free( values );
+    free( found );
+    return retval;
+}
+
+/*
+ * Print a stream of results that encode-all wrote with --output-format bin, in the text format of encode-all.
+ * With --fields, every field of the records is printed instead, one rule per line.
+ */
+int
+module_convertResults( rfca_opts_t opts, int argc, char** argv ) {
+    (void)opts;
+    bool fields =false;
+    if( argc > 0 && strcmp( argv[0], "--fields" ) == 0 ) {
+        fields =true;
+        argv++; argc--;
+    }
+    if( argc != 1 ) {
+        fprintf( stderr, "Error: Give one file of results, or - for the standard input\n" );
+        return -1;
+    }
+
+    FILE* f = strcmp( argv[0], "-" ) == 0 ? stdin : fopen( argv[0], "rb" );
+    if( !f ) {
+        fprintf( stderr, "Error: Cannot open `%s'\n", argv[0] );
+        return -1;
+    }
+    results_header_t h;
+    if( !results_readHeader( f, &h ) ) {
+        fprintf( stderr, "Error: `%s' does not contain results of encode-all\n", argv[0] );
+        if( f != stdin )
+            fclose( f );
+        return -1;
+    }
+    fprintf( stderr, "%s\n", h.description );
+
+    if( fields )
+        printf( "rule\tvalue\tuncompressed\tcompressed\tsteps\tpatterns\tseconds\n" );
+    else if( h.using >= 0 ) {
+        if( h.using == 0 ) {
+            printf( "%"PRIu64"", h.rulespace );
+            for( uint64_t i=0; i < h.rulespace; i++ )
+                printf( "\t%"PRIu64"", i );
+            printf( "\n" );
+        }
+        printf( "%d", (int)h.using );
+    }
+
+    results_record_t buffer[RESULTS_BUFFER];
+    size_t n;
+    while( (n = fread( buffer, sizeof( results_record_t ), RESULTS_BUFFER, f )) > 0 ) {
+        for( size_t i =0; i < n; i++ ) {
+            const results_record_t* r = &buffer[i];
+            if( fields )
+                printf( "%"PRIu64"\t%f\t%f\t%f\t%d\t%d\t%f\n",
+                    r->rule, r->value, r->uncompressed, r->compressed, (int)r->steps, (int)r->patterns, r->seconds );
+            else if( h.using >= 0 )
+                printf( "\t%f", r->value );
+            else
+                printf( "%"PRIu64" %f%%\n", r->rule, r->value );
+        }
+    }
+    if( !fields )
+        printf( "\n" );
+
+    if( f != stdin )
+        fclose( f );
+    return 0;
 }
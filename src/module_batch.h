@@ -14,6 +14,10 @@
 
 int module_encodeAll( rfca_opts_t opts, int argc, char** argv );
 
+int module_mergeCheckpoints( rfca_opts_t opts, int argc, char** argv );
+
+int module_convertResults( rfca_opts_t opts, int argc, char** argv );
+
 #endif
 
 
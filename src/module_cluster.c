@@ -0,0 +1,640 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // sysconf()
+
+#include "module_cluster.h"
+#include "vouw.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "cli.h"
+#include "sched.h"
+#include "cache.h"
+#include "matrix.h"
+#include "distance.h"
+
+// Number of k-medoids iterations at most, by default
+#define CLUSTER_ITERATIONS 100
+
+typedef enum { LINKAGE_SINGLE, LINKAGE_COMPLETE, LINKAGE_AVERAGE } cluster_linkage_t;
+
+/* One merge of the hierarchy, clusters are identified by one of their rules until the merges are numbered */
+typedef struct {
+    uint64_t a, b;
+    double distance;
+    uint64_t order;             // position in which the merge was found
+} cluster_merge_t;
+
+/* The distance of two rules is the mean of the cross-encoding ratios in both directions, or 0 if that is negative:
+ * a rule that is encoded at least as well with the code table of another rule as with its own is as near as it can be.
+ */
+typedef struct {
+    distance_ctx_t* dist;       // every rule is generated and self-encoded
+    uint64_t count;
+    double* matrix;             // all distances i < j in condensed form, only if the hierarchy is computed
+    matrix_t* store;            // optional, symmetric store of all distances
+    uint64_t* keys;             // otherwise the pairs computed so far, as i * count + j + 1 with i < j, 0 if empty
+    double* values;
+    uint64_t capacity, stored;
+    pthread_mutex_t lock;       // protects keys, values, capacity and stored
+    int k;
+    uint64_t* medoids;          // the rule of each cluster
+    int* medoidOf;              // the cluster of which every rule is the medoid, or -1
+    int* cluster;               // the cluster of every rule
+    double* nearest;            // the distance of every rule to the closest medoid
+    double* cost;               // the sum of distances of every rule to the members of its cluster
+    uint64_t** members;         // the rules of each cluster
+    uint64_t* memberCount;
+} cluster_ctx_t;
+
+static uint64_t
+cluster_index( uint64_t count, uint64_t i, uint64_t j ) {
+    return i * count - i * (i+1) / 2 + (j - i - 1);
+}
+
+static uint64_t
+cluster_mix( uint64_t x ) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t
+cluster_random( uint64_t* state ) {
+    return cluster_mix( *state += 0x9e3779b97f4a7c15ULL );
+}
+
+/*
+ * Find a pair in the table of computed distances, the caller holds the lock
+ */
+static bool
+cluster_lookup( const cluster_ctx_t* ctx, uint64_t key, double* value ) {
+    const uint64_t mask = ctx->capacity - 1;
+    for( uint64_t h = cluster_mix( key ) & mask; ctx->keys[h]; h = (h+1) & mask ) {
+        if( ctx->keys[h] == key ) {
+            *value = ctx->values[h];
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Add a pair to the table of computed distances unless it is there already, the caller holds the lock
+ */
+static void
+cluster_insert( cluster_ctx_t* ctx, uint64_t key, double value ) {
+    if( ctx->stored * 2 >= ctx->capacity ) {
+        const uint64_t oldCapacity = ctx->capacity;
+        uint64_t* oldKeys = ctx->keys;
+        double* oldValues = ctx->values;
+        ctx->capacity *= 2;
+        ctx->keys = (uint64_t*)calloc( ctx->capacity, sizeof( uint64_t ) );
+        ctx->values = (double*)malloc( sizeof( double ) * ctx->capacity );
+        ctx->stored =0;
+        for( uint64_t h =0; h < oldCapacity; h++ )
+            if( oldKeys[h] )
+                cluster_insert( ctx, oldKeys[h], oldValues[h] );
+        free( oldKeys );
+        free( oldValues );
+    }
+    const uint64_t mask = ctx->capacity - 1;
+    uint64_t h = cluster_mix( key ) & mask;
+    for( ; ctx->keys[h]; h = (h+1) & mask )
+        if( ctx->keys[h] == key )
+            return;
+    ctx->keys[h] = key;
+    ctx->values[h] = value;
+    ctx->stored++;
+}
+
+static double
+cluster_pairDistance( cluster_ctx_t* ctx, uint64_t i, uint64_t j, int worker ) {
+    const double d = (distance_cross( ctx->dist, i, j, worker ) + distance_cross( ctx->dist, j, i, worker )) / 2.0;
+    return d > 0.0 ? d : 0.0;
+}
+
+/*
+ * Returns the distance of rules i and j. Unless all distances have been computed in advance,
+ * a pair is cross-encoded the first time it is asked for.
+ */
+static double
+cluster_distance( cluster_ctx_t* ctx, uint64_t i, uint64_t j, int worker ) {
+    if( i == j )
+        return 0.0;
+    if( i > j ) {
+        uint64_t tmp = i;
+        i = j;
+        j = tmp;
+    }
+    if( ctx->matrix )
+        return ctx->matrix[cluster_index( ctx->count, i, j )];
+
+    const uint64_t key = i * ctx->count + j + 1;
+    double d;
+    pthread_mutex_lock( &ctx->lock );
+    const bool found = cluster_lookup( ctx, key, &d );
+    pthread_mutex_unlock( &ctx->lock );
+    if( found )
+        return d;
+
+    d = cluster_pairDistance( ctx, i, j, worker );
+    pthread_mutex_lock( &ctx->lock );
+    cluster_insert( ctx, key, d );
+    pthread_mutex_unlock( &ctx->lock );
+    return d;
+}
+
+/*
+ * Compute the distances of rule i to all later rules
+ */
+static void
+cluster_fillRow( void* arg, uint64_t i, int worker ) {
+    cluster_ctx_t* ctx = (cluster_ctx_t*)arg;
+    for( uint64_t j = i+1; j < ctx->count; j++ )
+        ctx->matrix[cluster_index( ctx->count, i, j )] = cluster_pairDistance( ctx, i, j, worker );
+    if( !ctx->store )
+        return;
+    // Rows are written by different workers, but never to the same values
+    matrix_set( ctx->store, i, i, 0.0 );
+    for( uint64_t j = i+1; j < ctx->count; j++ )
+        matrix_set( ctx->store, i, j, ctx->matrix[cluster_index( ctx->count, i, j )] );
+}
+
+/*
+ * Read the distances of rule i to all later rules from the store
+ */
+static void
+cluster_loadRow( void* arg, uint64_t i, int worker ) {
+    (void)worker;
+    cluster_ctx_t* ctx = (cluster_ctx_t*)arg;
+    for( uint64_t j = i+1; j < ctx->count; j++ )
+        ctx->matrix[cluster_index( ctx->count, i, j )] = matrix_get( ctx->store, i, j );
+}
+
+/*
+ * Move rule i to the closest medoid, the earliest one on ties. A medoid always stays in its own cluster.
+ */
+static void
+cluster_assign( void* arg, uint64_t i, int worker ) {
+    cluster_ctx_t* ctx = (cluster_ctx_t*)arg;
+    if( ctx->medoidOf[i] >= 0 ) {
+        ctx->nearest[i] =0.0;
+        ctx->cluster[i] = ctx->medoidOf[i];
+        return;
+    }
+    for( int c =0; c < ctx->k; c++ ) {
+        const double d = cluster_distance( ctx, i, ctx->medoids[c], worker );
+        if( c == 0 || d < ctx->nearest[i] ) {
+            ctx->nearest[i] = d;
+            ctx->cluster[i] = c;
+        }
+    }
+}
+
+/*
+ * Update the distance of rule i to the closest medoid with the medoid that was added last
+ */
+static void
+cluster_addMedoid( void* arg, uint64_t i, int worker ) {
+    cluster_ctx_t* ctx = (cluster_ctx_t*)arg;
+    const int c = ctx->k - 1;
+    const double d = cluster_distance( ctx, i, ctx->medoids[c], worker );
+    if( c == 0 || d < ctx->nearest[i] || ctx->medoidOf[i] == c ) {
+        ctx->nearest[i] = d;
+        ctx->cluster[i] = c;
+    }
+}
+
+/*
+ * Sum the distances of rule i to the other members of its cluster
+ */
+static void
+cluster_cost( void* arg, uint64_t i, int worker ) {
+    cluster_ctx_t* ctx = (cluster_ctx_t*)arg;
+    const int c = ctx->cluster[i];
+    double cost =0.0;
+    for( uint64_t m =0; m < ctx->memberCount[c]; m++ )
+        cost += cluster_distance( ctx, i, ctx->members[c][m], worker );
+    ctx->cost[i] = cost;
+}
+
+/*
+ * Partition the rules into k clusters around medoids. The first medoid is the given rule,
+ * the others are drawn with a probability proportional to the squared distance to the closest
+ * medoid so far. Then every rule is assigned to its closest medoid and every medoid is replaced by
+ * the member with the smallest sum of distances to the other members, until the medoids stay the same.
+ * Only the distances of rules to medoids and of rules within the same cluster are computed.
+ * Returns the number of iterations.
+ */
+static int
+cluster_medoids( cluster_ctx_t* ctx, int k, uint64_t first, uint64_t seed, int iterations, int threads ) {
+    const uint64_t n = ctx->count;
+    ctx->medoids = (uint64_t*)malloc( sizeof( uint64_t ) * k );
+    ctx->cluster = (int*)malloc( sizeof( int ) * n );
+    ctx->nearest = (double*)malloc( sizeof( double ) * n );
+    ctx->cost = (double*)malloc( sizeof( double ) * n );
+    ctx->members = (uint64_t**)malloc( sizeof( uint64_t* ) * k );
+    ctx->memberCount = (uint64_t*)calloc( k, sizeof( uint64_t ) );
+    ctx->medoidOf = (int*)malloc( sizeof( int ) * n );
+    for( uint64_t i =0; i < n; i++ )
+        ctx->medoidOf[i] =-1;
+
+    for( ctx->k =1; ; ctx->k++ ) {
+        const int c = ctx->k - 1;
+        if( c == 0 )
+            ctx->medoids[c] = first;
+        else {
+            double total =0.0;
+            for( uint64_t i =0; i < n; i++ )
+                if( ctx->medoidOf[i] < 0 && ctx->nearest[i] > 0.0 )
+                    total += ctx->nearest[i] * ctx->nearest[i];
+            // Draw from [0,total) with 53 random bits; if all remaining rules have distance 0, take the first
+            double x = (double)(cluster_random( &seed ) >> 11) / 9007199254740992.0 * total;
+            uint64_t pick = n, fallback = n;
+            for( uint64_t i =0; i < n && pick == n; i++ ) {
+                if( ctx->medoidOf[i] >= 0 )
+                    continue;
+                if( fallback == n )
+                    fallback = i;
+                if( ctx->nearest[i] > 0.0 ) {
+                    x -= ctx->nearest[i] * ctx->nearest[i];
+                    if( x < 0.0 )
+                        pick = i;
+                }
+            }
+            ctx->medoids[c] = pick < n ? pick : fallback;
+        }
+        ctx->medoidOf[ctx->medoids[c]] = c;
+        sched_run( 0, n, threads, cluster_addMedoid, NULL, ctx );
+        if( ctx->k == k )
+            break;
+    }
+
+    int iter;
+    for( iter =1; iter <= iterations; iter++ ) {
+        for( int c =0; c < k; c++ )
+            ctx->memberCount[c] =0;
+        for( uint64_t i =0; i < n; i++ )
+            ctx->memberCount[ctx->cluster[i]]++;
+        for( int c =0; c < k; c++ ) {
+            ctx->members[c] = (uint64_t*)realloc( iter == 1 ? NULL : ctx->members[c], sizeof( uint64_t ) * (ctx->memberCount[c] + 1) );
+            ctx->memberCount[c] =0;
+        }
+        for( uint64_t i =0; i < n; i++ ) {
+            const int c = ctx->cluster[i];
+            ctx->members[c][ctx->memberCount[c]++] = i;
+        }
+        sched_run( 0, n, threads, cluster_cost, NULL, ctx );
+
+        bool changed =false;
+        for( int c =0; c < k; c++ ) {
+            uint64_t best = ctx->medoids[c];
+            for( uint64_t m =0; m < ctx->memberCount[c]; m++ ) {
+                const uint64_t i = ctx->members[c][m];
+                if( ctx->cost[i] < ctx->cost[best] || (ctx->cost[i] == ctx->cost[best] && i < best) )
+                    best = i;
+            }
+            if( best != ctx->medoids[c] ) {
+                ctx->medoidOf[ctx->medoids[c]] =-1;
+                ctx->medoidOf[best] = c;
+                ctx->medoids[c] = best;
+                changed =true;
+            }
+        }
+        if( !changed )
+            break;
+        sched_run( 0, n, threads, cluster_assign, NULL, ctx );
+    }
+
+    return iter > iterations ? iterations : iter;
+}
+
+static int
+cluster_cmpMerge( const void* a, const void* b ) {
+    const cluster_merge_t* ma = (const cluster_merge_t*)a;
+    const cluster_merge_t* mb = (const cluster_merge_t*)b;
+    if( ma->distance != mb->distance )
+        return ma->distance < mb->distance ? -1 : 1;
+    return ma->order < mb->order ? -1 : ma->order > mb->order;
+}
+
+static uint64_t
+cluster_find( uint64_t* parent, uint64_t x ) {
+    while( parent[x] != x )
+        x = parent[x] = parent[parent[x]];
+    return x;
+}
+
+/*
+ * Build the hierarchy with the nearest-neighbour chain algorithm, using all distances in ctx->matrix,
+ * which are overwritten. Every merge is written to f as a line `a b distance size', in order of distance,
+ * where a and b are rules if smaller than the number of rules n, and otherwise the cluster formed by merge a - n.
+ */
+static void
+cluster_hierarchy( cluster_ctx_t* ctx, cluster_linkage_t linkage, FILE* f ) {
+    const uint64_t n = ctx->count;
+    // A single rule is never merged
+    if( n < 2 )
+        return;
+    double* d = ctx->matrix;
+    uint64_t* size = (uint64_t*)malloc( sizeof( uint64_t ) * n );
+    bool* active = (bool*)malloc( sizeof( bool ) * n );
+    uint64_t* chain = (uint64_t*)malloc( sizeof( uint64_t ) * n );
+    cluster_merge_t* merges = (cluster_merge_t*)malloc( sizeof( cluster_merge_t ) * n );
+    uint64_t chainSize =0;
+    for( uint64_t i =0; i < n; i++ ) {
+        size[i] =1;
+        active[i] =true;
+    }
+
+    for( uint64_t m =0; m + 1 < n; m++ ) {
+        if( chainSize == 0 ) {
+            uint64_t i =0;
+            while( !active[i] )
+                i++;
+            chain[chainSize++] = i;
+        }
+        uint64_t x, y;
+        for( ;; ) {
+            // The nearest active cluster, preferring the previous cluster in the chain on ties
+            x = chain[chainSize-1];
+            y = chainSize > 1 ? chain[chainSize-2] : n;
+            double best = y < n ? d[x < y ? cluster_index( n, x, y ) : cluster_index( n, y, x )] : INFINITY;
+            for( uint64_t i =0; i < n; i++ ) {
+                if( !active[i] || i == x )
+                    continue;
+                const double di = d[x < i ? cluster_index( n, x, i ) : cluster_index( n, i, x )];
+                if( di < best || y == n ) {
+                    best = di;
+                    y = i;
+                }
+            }
+            if( chainSize > 1 && y == chain[chainSize-2] )
+                break;
+            chain[chainSize++] = y;
+        }
+        chainSize -= 2;
+
+        // Merge x into y using the Lance-Williams update of the linkage
+        merges[m].a = x;
+        merges[m].b = y;
+        merges[m].distance = d[x < y ? cluster_index( n, x, y ) : cluster_index( n, y, x )];
+        merges[m].order = m;
+        active[x] =false;
+        for( uint64_t i =0; i < n; i++ ) {
+            if( !active[i] || i == y )
+                continue;
+            const double dx = d[x < i ? cluster_index( n, x, i ) : cluster_index( n, i, x )];
+            double* dy = &d[y < i ? cluster_index( n, y, i ) : cluster_index( n, i, y )];
+            if( linkage == LINKAGE_SINGLE )
+                *dy = dx < *dy ? dx : *dy;
+            else if( linkage == LINKAGE_COMPLETE )
+                *dy = dx > *dy ? dx : *dy;
+            else
+                *dy = (size[x] * dx + size[y] * *dy) / (double)(size[x] + size[y]);
+        }
+        size[y] += size[x];
+    }
+
+    // Number the clusters in order of distance, as in a SciPy linkage matrix
+    qsort( merges, n - 1, sizeof( cluster_merge_t ), cluster_cmpMerge );
+    uint64_t* parent = (uint64_t*)malloc( sizeof( uint64_t ) * (2*n - 1) );
+    uint64_t* members = (uint64_t*)malloc( sizeof( uint64_t ) * (2*n - 1) );
+    for( uint64_t i =0; i < 2*n - 1; i++ ) {
+        parent[i] = i;
+        members[i] =1;
+    }
+    for( uint64_t m =0; m + 1 < n; m++ ) {
+        uint64_t a = cluster_find( parent, merges[m].a );
+        uint64_t b = cluster_find( parent, merges[m].b );
+        if( a > b ) {
+            uint64_t tmp = a;
+            a = b;
+            b = tmp;
+        }
+        parent[a] = parent[b] = n + m;
+        members[n + m] = members[a] + members[b];
+        fprintf( f, "%"PRIu64" %"PRIu64" %f %"PRIu64"\n", a, b, merges[m].distance, members[n + m] );
+    }
+
+    free( parent );
+    free( members );
+    free( size );
+    free( active );
+    free( chain );
+    free( merges );
+}
+
+/*
+ * Cluster the rules of the specified rulespace by the mean of their cross-encoding ratios in both directions, see cluster_ctx_t.
+ * With -k, the rules are partitioned around k medoids and only the distances that are needed are computed.
+ * With --dendrogram, all distances are computed and the hierarchy of the given linkage is written to a file.
+ * With --store, all distances are computed and kept in a symmetric matrix store, from which later runs read them.
+ */
+int
+module_cluster( rfca_opts_t opts, int argc, char** argv ) {
+    uint64_t rulespace = rfca_maxRules( opts.base, opts.mode );
+    int threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    int rc, k =0, iterations =CLUSTER_ITERATIONS;
+    uint64_t seed =0;
+    cluster_linkage_t linkage =LINKAGE_AVERAGE;
+    const char* cachePath =NULL;
+    const char* dendrogramPath =NULL;
+    const char* storePath =NULL;
+
+    if( !cli_checkGenerated( &opts ) )
+        return -1;
+
+    while( argc > 0 ) {
+        if( (rc = sched_parseThreads( &threads, &argv, &argc )) < 0 ) {
+            fprintf( stderr, "Error: Parameter `threads' requires a positive number\n" );
+            return -1;
+        } else if( rc > 0 )
+            continue;
+        if( argc < 2 ) {
+            fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+            return -1;
+        }
+        if( strcmp( argv[0], "-k" ) == 0 ) {
+            if( (k = atoi( argv[1] )) < 1 || (uint64_t)k > rulespace ) {
+                fprintf( stderr, "Error: Parameter `k' must be between 1 and the number of rules\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--iterations" ) == 0 ) {
+            if( (iterations = atoi( argv[1] )) < 1 ) {
+                fprintf( stderr, "Error: Parameter `iterations' requires a positive number\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--seed" ) == 0 ) {
+            seed = strtoull( argv[1], NULL, 0 );
+        } else if( strcmp( argv[0], "--linkage" ) == 0 ) {
+            if( strcmp( argv[1], "single" ) == 0 )
+                linkage =LINKAGE_SINGLE;
+            else if( strcmp( argv[1], "complete" ) == 0 )
+                linkage =LINKAGE_COMPLETE;
+            else if( strcmp( argv[1], "average" ) == 0 )
+                linkage =LINKAGE_AVERAGE;
+            else {
+                fprintf( stderr, "Error: Parameter `linkage' must be single, complete or average\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--dendrogram" ) == 0 ) {
+            dendrogramPath = argv[1];
+        } else if( strcmp( argv[0], "--cache" ) == 0 ) {
+            cachePath = argv[1];
+        } else if( strcmp( argv[0], "--store" ) == 0 ) {
+            storePath = argv[1];
+        } else {
+            fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+            return -1;
+        }
+        argv += 2; argc -= 2;
+    }
+    if( !k && !dendrogramPath && !storePath ) {
+        fprintf( stderr, "Error: Give the number of clusters with -k, a dendrogram file with --dendrogram and/or a matrix store with --store\n" );
+        return -1;
+    }
+    if( threads < 1 )
+        threads =1;
+
+    FILE* dendrogram =NULL;
+    if( dendrogramPath && !(dendrogram = fopen( dendrogramPath, "w" )) ) {
+        fprintf( stderr, "Error: Cannot open dendrogram file `%s'\n", dendrogramPath );
+        return -1;
+    }
+
+    matrix_t* store =NULL;
+    if( storePath ) {
+        char description[MATRIX_DESCRIPTION_MAX];
+        rfca_opts_t classOpts = opts;
+        classOpts.rule =0;
+        int n = snprintf( description, sizeof( description ), "vouw cluster " );
+        cli_formatOpts( description + n, sizeof( description ) - n, &classOpts );
+        if( !(store = matrix_create( storePath, rulespace, DISTANCE_TILE, true, description )) ) {
+            if( dendrogram )
+                fclose( dendrogram );
+            return -1;
+        }
+    }
+    // A complete store makes the self-encodings unnecessary
+    const bool stored = store && matrix_isComplete( store );
+
+    distance_ctx_t dist;
+    dist.cache =NULL;
+    dist.store =NULL;
+    if( cachePath ) {
+        dist.cache = cache_open( cachePath );
+        if( !dist.cache ) {
+            if( dendrogram )
+                fclose( dendrogram );
+            if( store )
+                matrix_close( store );
+            return -1;
+        }
+    }
+    dist.opts =opts;
+    dist.count =rulespace;
+    dist.lazy =true;
+    dist.rules = (distance_rule_t*)malloc( sizeof( distance_rule_t ) * rulespace );
+    vouw_scratch_t* scratch[threads];
+    for( int i =0; i < threads; i++ )
+        scratch[i] = vouw_scratch_create();
+    dist.scratch =scratch;
+    dist.group.count =1;
+
+    fprintf( stderr, "Now encoding RFCA class: %d.%d for %"PRIu64" rules on %d threads\n",
+        opts.mode, opts.base, rulespace, threads );
+    sched_run( 0, rulespace, threads, distance_generate, NULL, &dist );
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        distance_rule_t* dr = &dist.rules[i];
+        dr->canonical = dr->same = dr->source = i;
+        dr->map =0;
+        dr->encode =!stored;
+    }
+    sched_run( 0, rulespace, threads, distance_selfEncode, NULL, &dist );
+
+    cluster_ctx_t ctx;
+    ctx.dist =&dist;
+    ctx.count =rulespace;
+    ctx.matrix =NULL;
+    ctx.store =store;
+    ctx.capacity =1024;
+    ctx.keys = (uint64_t*)calloc( ctx.capacity, sizeof( uint64_t ) );
+    ctx.values = (double*)malloc( sizeof( double ) * ctx.capacity );
+    ctx.stored =0;
+    ctx.medoids =NULL;
+    pthread_mutex_init( &ctx.lock, NULL );
+
+    const uint64_t pairs = rulespace * (rulespace - 1) / 2;
+    if( stored ) {
+        fprintf( stderr, "Reading the distances of all %"PRIu64" pairs from the store\n", pairs );
+        ctx.matrix = (double*)malloc( sizeof( double ) * (pairs ? pairs : 1) );
+        sched_run( 0, rulespace, threads, cluster_loadRow, NULL, &ctx );
+    } else if( dendrogram || store ) {
+        fprintf( stderr, "Computing the distances of all %"PRIu64" pairs\n", pairs );
+        ctx.matrix = (double*)malloc( sizeof( double ) * (pairs ? pairs : 1) );
+        sched_run( 0, rulespace, threads, cluster_fillRow, NULL, &ctx );
+        if( store ) {
+            for( uint64_t ti =0; ti < store->tilesPerRow; ti++ )
+                for( uint64_t tj = ti; tj < store->tilesPerRow; tj++ )
+                    matrix_setDone( store, ti, tj );
+        }
+    }
+
+    if( k ) {
+        const int iter = cluster_medoids( &ctx, k, opts.rule, seed, iterations, threads );
+        double total =0.0;
+        for( uint64_t i =0; i < rulespace; i++ )
+            total += ctx.nearest[i];
+        fprintf( stderr, "%d clusters after %d iterations, sum of distances to the medoids %f\n", k, iter, total );
+        if( !ctx.matrix )
+            fprintf( stderr, "Computed the distances of %"PRIu64" of %"PRIu64" pairs (%.1f%%)\n",
+                ctx.stored, pairs, pairs ? (double)ctx.stored / (double)pairs * 100.0 : 0.0 );
+        for( uint64_t i =0; i < rulespace; i++ )
+            printf( "%"PRIu64"\t%d\t%"PRIu64"\n", i, ctx.cluster[i], ctx.medoids[ctx.cluster[i]] );
+        for( int c =0; c < k; c++ )
+            free( ctx.members[c] );
+        free( ctx.medoids );
+        free( ctx.medoidOf );
+        free( ctx.cluster );
+        free( ctx.nearest );
+        free( ctx.cost );
+        free( ctx.members );
+        free( ctx.memberCount );
+    }
+
+    if( dendrogram ) {
+        cluster_hierarchy( &ctx, linkage, dendrogram );
+        fclose( dendrogram );
+    }
+    free( ctx.matrix );
+    if( store )
+        matrix_close( store );
+
+    pthread_mutex_destroy( &ctx.lock );
+    free( ctx.keys );
+    free( ctx.values );
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        vouw_target_free( dist.rules[i].target );
+        if( dist.rules[i].v )
+            vouw_free( dist.rules[i].v );
+        rfca_free( dist.rules[i].rfca );
+    }
+    for( int i =0; i < threads; i++ )
+        vouw_scratch_free( scratch[i] );
+    if( dist.cache ) {
+        cache_printStats( dist.cache, stderr );
+        cache_close( dist.cache );
+    }
+    free( dist.rules );
+    return 0;
+}
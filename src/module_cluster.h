@@ -0,0 +1,17 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef MODULE_CLUSTER_H
+#define MODULE_CLUSTER_H
+
+// Clusters the rules of a rulespace by their cross-encoding distances
+
+#include "rfca.h"
+
+int module_cluster( rfca_opts_t opts, int argc, char** argv );
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // sysconf()
+
+#include "module_distance.h"
+#include "vouw.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cli.h"
+#include "sched.h"
+#include "symmetry.h"
+#include "dedupe.h"
+#include "cache.h"
+#include "matrix.h"
+#include "distance.h"
+
+/*
+ * Cross-encode the columns of one tile of the current band.
+ * Each target is encoded with all code tables in the band while it is still in cache.
+ * Columns that are identical to an earlier column are not computed.
+ */
+static void
+distance_crossTile( void* arg, uint64_t tile, int worker ) {
+    distance_ctx_t* ctx = (distance_ctx_t*)arg;
+    const uint64_t first = tile * DISTANCE_TILE;
+    const uint64_t last = first + DISTANCE_TILE < ctx->count ? first + DISTANCE_TILE : ctx->count;
+
+    for( uint64_t j = first; j < last; j++ ) {
+        if( ctx->rules[j].same != j )
+            continue;
+        for( int k =0; k < ctx->slotCount; k++ )
+            ctx->values[k * ctx->count + j] = distance_cross( ctx, ctx->slots[k], j, worker );
+    }
+}
+
+/*
+ * Returns the entry in column j of row i of the current band.
+ * Row i equals row f(i) of its canonical rule, with column j moved to f(j).
+ */
+static double
+distance_value( const distance_ctx_t* ctx, uint64_t i, uint64_t j ) {
+    const distance_rule_t* dr = &ctx->rules[i];
+    const uint64_t t = dr->map ? ctx->perm[dr->map][j] : j;
+    return ctx->values[ctx->slotOf[i - ctx->band] * ctx->count + ctx->rules[t].same];
+}
+
+/*
+ * Write one tile of the current band to the store and mark it as done
+ */
+static void
+distance_storeTile( void* arg, uint64_t tile, int worker ) {
+    (void)worker;
+    distance_ctx_t* ctx = (distance_ctx_t*)arg;
+    const uint64_t first = tile * DISTANCE_TILE;
+    const uint64_t last = first + DISTANCE_TILE < ctx->count ? first + DISTANCE_TILE : ctx->count;
+    double* values = matrix_tile( ctx->store, ctx->band / DISTANCE_TILE, tile );
+
+    for( uint64_t i = ctx->band; i < ctx->band + DISTANCE_TILE && i < ctx->count; i++ )
+        for( uint64_t j = first; j < last; j++ )
+            values[(i - ctx->band) * DISTANCE_TILE + j - first] = distance_value( ctx, i, j );
+    matrix_setDone( ctx->store, ctx->band / DISTANCE_TILE, tile );
+}
+
+/*
+ * Returns true if all tiles of the band that starts at row band are in the store
+ */
+static bool
+distance_isStored( const distance_ctx_t* ctx, uint64_t band ) {
+    for( uint64_t t =0; t < ctx->store->tilesPerRow; t++ )
+        if( !matrix_isDone( ctx->store, band / DISTANCE_TILE, t ) )
+            return false;
+    return true;
+}
+
+/*
+ * Compute the cross-encoding ratio of every pair of rules in the rulespace.
+ * Every rule is generated once and one rule of each symmetry class is self-encoded,
+ * after which the matrix is computed in bands of DISTANCE_TILE rows. Rules that generate
+ * the same automaton share their self-encoding and their cross-encodings.
+ * The output is the same as that of `encode-all using -r X' for X = 0 .. rulespace-1, concatenated.
+ * With --store the matrix is written to a tiled matrix store instead, which `matrix' can query and export.
+ * Bands that are already in the store are skipped, so an interrupted run can be resumed.
+ */
+int
+module_distanceMatrix( rfca_opts_t opts, int argc, char** argv ) {
+    uint64_t rulespace = rfca_maxRules( opts.base, opts.mode );
+    int threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    int rc;
+    bool symmetry =true;
+    bool dedupe =true;
+    const char* cachePath =NULL;
+    const char* storePath =NULL;
+
+    if( !cli_checkGenerated( &opts ) )
+        return -1;
+
+    while( argc > 0 ) {
+        if( (rc = sched_parseThreads( &threads, &argv, &argc )) < 0 ) {
+            fprintf( stderr, "Error: Parameter `threads' requires a positive number\n" );
+            return -1;
+        } else if( rc > 0 )
+            continue;
+        if( strcmp( argv[0], "--store" ) == 0 && argc > 1 ) {
+            storePath = argv[1];
+            argv += 2; argc -= 2;
+        } else if( strcmp( argv[0], "--no-symmetry" ) == 0 ) {
+            symmetry =false;
+            argv++; argc--;
+        } else if( strcmp( argv[0], "--no-dedupe" ) == 0 ) {
+            dedupe =false;
+            argv++; argc--;
+        } else if( strcmp( argv[0], "--cache" ) == 0 && argc > 1 ) {
+            cachePath = argv[1];
+            argv += 2; argc -= 2;
+        } else {
+            fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+            return -1;
+        }
+    }
+    if( threads < 1 )
+        threads =1;
+
+    distance_ctx_t ctx;
+    ctx.cache =NULL;
+    ctx.store =NULL;
+    ctx.lazy =false;
+    if( storePath ) {
+        char description[MATRIX_DESCRIPTION_MAX];
+        rfca_opts_t classOpts = opts;
+        classOpts.rule =0;
+        int n = snprintf( description, sizeof( description ), "vouw distance-matrix " );
+        cli_formatOpts( description + n, sizeof( description ) - n, &classOpts );
+        ctx.store = matrix_create( storePath, rulespace, DISTANCE_TILE, false, description );
+        if( !ctx.store )
+            return -1;
+    }
+    if( cachePath ) {
+        ctx.cache = cache_open( cachePath );
+        if( !ctx.cache ) {
+            if( ctx.store )
+                matrix_close( ctx.store );
+            return -1;
+        }
+    }
+    ctx.opts =opts;
+    ctx.count =rulespace;
+    ctx.rules = (distance_rule_t*)malloc( sizeof( distance_rule_t ) * rulespace );
+    ctx.values = (double*)malloc( sizeof( double ) * DISTANCE_TILE * rulespace );
+    vouw_scratch_t* scratch[threads];
+    for( int i =0; i < threads; i++ )
+        scratch[i] = vouw_scratch_create();
+    ctx.scratch =scratch;
+
+    symmetry_group_init( &ctx.group, &opts );
+    if( !symmetry )
+        ctx.group.count =1;
+    for( int m =1; m < ctx.group.count; m++ ) {
+        ctx.perm[m] = (uint64_t*)malloc( sizeof( uint64_t ) * rulespace );
+        for( uint64_t i =0; i < rulespace; i++ )
+            ctx.perm[m][i] = symmetry_apply( &ctx.group, m, i );
+    }
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        distance_rule_t* dr = &ctx.rules[i];
+        dr->canonical = symmetry_canonical( &ctx.group, i, 0, &dr->map );
+    }
+
+    fprintf( stderr, "Now generating RFCA class: %d.%d for %"PRIu64" rules on %d threads\n",
+        opts.mode, opts.base, rulespace, threads );
+    sched_run( 0, rulespace, threads, distance_generate, NULL, &ctx );
+
+    // Rules are compared in rule order, so the first rule of each group of identical automata is kept
+    dedupe_t* d = dedupe ? dedupe_create() : NULL;
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        distance_rule_t* dr = &ctx.rules[i];
+        dr->same = i;
+        if( d ) {
+            bool found;
+            dedupe_entry_t* e = dedupe_acquire( d, dr->rfca, i, &found );
+            if( found )
+                dr->same = e->rule;
+            else
+                dedupe_publish( d, e, 0.0 );
+        }
+    }
+    // Every self-encoding is needed for the columns, unless the store holds all bands already
+    const bool stored = ctx.store && matrix_isComplete( ctx.store );
+    uint64_t encodeCount =0;
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        distance_rule_t* dr = &ctx.rules[i];
+        dr->source = ctx.rules[dr->canonical].same;
+        if( stored )
+            continue;
+        if( !ctx.rules[dr->source].encode )
+            encodeCount++;
+        ctx.rules[dr->source].encode =true;
+    }
+    if( d ) {
+        dedupe_printStats( d, stderr );
+        dedupe_free( d );
+    }
+
+    fprintf( stderr, "Self-encoding %"PRIu64" rules\n", encodeCount );
+    sched_run( 0, rulespace, threads, distance_selfEncode, NULL, &ctx );
+    for( uint64_t i =0; i < rulespace; i++ )
+        ctx.rules[i].compressed = ctx.rules[ctx.rules[i].source].compressed;
+
+    if( !ctx.store ) {
+        printf( "%"PRIu64"", rulespace );
+        for( uint64_t i=0; i < rulespace; i++ )
+            printf( "\t%"PRIu64"", i );
+        printf( "\n" );
+    }
+
+    const uint64_t tiles = (rulespace + DISTANCE_TILE - 1) / DISTANCE_TILE;
+    for( ctx.band =0; ctx.band < rulespace; ctx.band += DISTANCE_TILE ) {
+        if( ctx.store && distance_isStored( &ctx, ctx.band ) )
+            continue;
+
+        // Rows with the same source are computed once
+        ctx.slotCount =0;
+        for( uint64_t i = ctx.band; i < ctx.band + DISTANCE_TILE && i < rulespace; i++ ) {
+            const uint64_t source = ctx.rules[i].source;
+            int k =0;
+            while( k < ctx.slotCount && ctx.slots[k] != source )
+                k++;
+            if( k == ctx.slotCount )
+                ctx.slots[ctx.slotCount++] = source;
+            ctx.slotOf[i - ctx.band] = k;
+        }
+
+        fprintf( stderr, "Cross-encoding %"PRIu64" (%.1f%%)...", ctx.band, (double)ctx.band/(double)rulespace * 100.0 );
+        sched_run( 0, tiles, threads, distance_crossTile, NULL, &ctx );
+        fprintf( stderr, "done.\n" );
+
+        if( ctx.store ) {
+            sched_run( 0, tiles, threads, distance_storeTile, NULL, &ctx );
+            continue;
+        }
+        for( uint64_t i = ctx.band; i < ctx.band + DISTANCE_TILE && i < rulespace; i++ ) {
+            printf( "%d", (int)i );
+            for( uint64_t j =0; j < rulespace; j++ )
+                printf( "\t%f", distance_value( &ctx, i, j ) );
+            printf( "\n" );
+        }
+    }
+
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        vouw_target_free( ctx.rules[i].target );
+        if( ctx.rules[i].v )
+            vouw_free( ctx.rules[i].v );
+        rfca_free( ctx.rules[i].rfca );
+    }
+    for( int m =1; m < ctx.group.count; m++ )
+        free( ctx.perm[m] );
+    for( int i =0; i < threads; i++ )
+        vouw_scratch_free( scratch[i] );
+    if( ctx.cache ) {
+        cache_printStats( ctx.cache, stderr );
+        cache_close( ctx.cache );
+    }
+    if( ctx.store )
+        matrix_close( ctx.store );
+    free( ctx.rules );
+    free( ctx.values );
+    return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef MODULE_DISTANCE_H
+#define MODULE_DISTANCE_H
+
+// Computes the cross-encoding ratio of every pair of rules in a rulespace
+
+#include "rfca.h"
+
+int module_distanceMatrix( rfca_opts_t opts, int argc, char** argv );
+
+#endif
@@ -5,17 +5,89 @@
  * Leiden Institute for Advanced Computer Science
  */
 
+#define _POSIX_C_SOURCE 200809L // clock_gettime(), sysconf()
+
 #include "module_encode.h"
 #include "module_print.h"
 #include "vouw.h"
+#include "codec.h"
+#include "query.h"
+#include "sched.h"
 #include "list.h"
 #include <stdio.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
 #include "cli.h"
 
+static double
+encode_now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Write the encoding of v to a file and compare its size to the encoded length of v.
+ * Throughput is given in bytes of the automaton, at one byte per node.
+ */
+static bool
+encode_writeFile( vouw_t* v, const char* path ) {
+    FILE* f = fopen( path, "wb" );
+    if( !f ) {
+        fprintf( stderr, "Error: Cannot open `%s'\n", path );
+        return false;
+    }
+    const double start = encode_now();
+    const uint64_t bytes = codec_write( v, f );
+    fclose( f );
+    const double seconds = encode_now() - start;
+
+    // The header and the input are not part of the estimate
+    const double estimate = v->ctBits + v->encodedBits;
+    const double coded = (double)(bytes - sizeof( codec_header_t ) - v->rfca->opts.inputSize) * 8.0;
+    fprintf( stderr, "Wrote %"PRIu64" bytes to `%s' in %f s, %.1f MB/s\n",
+        bytes, path, seconds, (double)v->rfca->buffer->nodeCount / seconds / 1e6 );
+    fprintf( stderr, "Coded length %.0f bits, estimated length %.0f bits (%+.2f%%)\n",
+        coded, estimate, (coded - estimate) / estimate * 100.0 );
+    return true;
+}
+
+/*
+ * Open the merge log of the encoding of v and replay the merges it already holds.
+ * Merges are appended to it from here on, so an encoding that was cut short continues where it stopped.
+ */
+static mergelog_t*
+encode_openLog( vouw_t* v, const char* path ) {
+    const rfca_opts_t* opts = &v->rfca->opts;
+    char header[MERGELOG_HEADER_MAX];
+    int n = snprintf( header, sizeof( header ), "vouw merges %d.%d.%"PRIu64" input ", opts->mode, opts->base, opts->rule );
+    for( int i =0; i < opts->inputSize && n < (int)sizeof( header ); i++ )
+        n += snprintf( header + n, sizeof( header ) - n, "%d", (int)opts->input[i] );
+    if( n < (int)sizeof( header ) )
+        snprintf( header + n, sizeof( header ) - n, " folds %d right %d", opts->folds, opts->right ? 1 : 0 );
+
+    mergelog_t* log = mergelog_open( path, header );
+    if( !log || log->count == 0 )
+        return log;
+
+    const double start = encode_now();
+    const uint64_t replayed = vouw_replay( v, log );
+    const double seconds = encode_now() - start;
+    if( replayed != log->count ) {
+        fprintf( stderr, "Error: Merge %"PRIu64" of `%s' does not match the code table\n", replayed + 1, path );
+        mergelog_close( log );
+        return NULL;
+    }
+    fprintf( stderr, "Replayed %"PRIu64" merges from `%s' in %f s%s\n",
+        replayed, path, seconds, log->finished ? "" : ", resuming the encoding" );
+    return log;
+}
+
 void
 vouw_print( vouw_t* v  ) {
     // Label all the patterns so we can print them
@@ -47,17 +119,11 @@ vouw_print( vouw_t* v  ) {
         }
         fprintf( stdout, "\n" );
     }*/
-    for( int i =0; i < print->rowCount; i++ ) {
-        for( int k =0; k < i * (print->mode-1); k++ )
-            fprintf( stdout, " " );
-        for( int j =0; j < rfca_buffer_rowLength( print, i ); j++ ) {
-            rfca_coord_t c = {i, j};
-            char label = (char)rfca_buffer_value( print, c );
-            fprintf( stdout, "%c", label );
-            fprintf( stdout, " " );
-        }
-        fprintf( stdout, "\n" );
-    }
+    // The nodes hold the labels themselves
+    char table[PRINT_TABLE_SIZE];
+    for( int i =0; i < PRINT_TABLE_SIZE; i++ )
+        table[i] = (char)i;
+    print_buffer( stdout, print, false, table, PRINT_PRETTY );
     rfca_buffer_free( print );
 
     // Print some stats
@@ -79,16 +145,32 @@ vouw_printCodeTable( vouw_t* v ) {
 }
 
 int module_encode( rfca_opts_t opts, int argc, char** argv ) {
+    int retval =0;
     rfca_t* r1 = rfca_create( opts );
     rfca_generate( r1 );
 
     rfca_t* r2 = r1;
     rfca_opts_t opts2 = opts;
+    const char* outPath =NULL;
+    // The decoded automaton is written in bands of rows on all cores
+    const int threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
 
+    const char* logPath =NULL;
+    while( argc > 1 && (strcmp( argv[0], "--out" ) == 0 || strcmp( argv[0], "--log" ) == 0) ) {
+        if( strcmp( argv[0], "--out" ) == 0 )
+            outPath = argv[1];
+        else
+            logPath = argv[1];
+        argv += 2; argc -= 2;
+    }
     if( argc > 0 && strcmp( argv[0], "using" ) == 0 ) {
 
         argv++; argc--;
+        // The automaton of `using' is generated, unless it is given with a --from-file of its own
+        opts2.file =NULL;
         if( !cli_parseOpts( &opts2, &argv, &argc ) ) {
+            if( opts2.input != opts.input )
+                free( opts2.input );
             rfca_free( r1 );
             return -1;
         }
@@ -101,17 +183,30 @@ int module_encode( rfca_opts_t opts, int argc, char** argv ) {
 
     vouw_t* v = vouw_createFrom( r2 );
     double uncompressed = v->ctBits + v->encodedBits;
-    vouw_encode( v );
+    if( logPath ) {
+        v->log = encode_openLog( v, logPath );
+        if( !v->log ) {
+            vouw_free( v );
+            if( r2 != r1 )
+                rfca_free( r2 );
+            rfca_free( r1 );
+            return -1;
+        }
+    }
+    if( !v->log || !v->log->finished )
+        vouw_encode( v );
     vouw_print( v );
     double compressed = v->ctBits + v->encodedBits;
     printf( "Compression ratio: %f%%\n", compressed / uncompressed * 100.0 );
     vouw_printCodeTable( v );
 
-    rfca_t* r_prime = vouw_decode( v );
-    rfca_print( r_prime, true );
+    rfca_t* r_prime = vouw_decodeParallel( v, threads );
+    rfca_print( r_prime, PRINT_PRETTY );
     printf( "Correct output? %s\n", rfca_buffer_isEqual( r2->buffer, r_prime->buffer ) ? "yes" : "no" );
 
     rfca_free( r_prime );
+    if( outPath && r1 == r2 && !encode_writeFile( v, outPath ) )
+        retval =-1;
 
     if( r1 != r2 ) {
         fprintf( stderr, "Now encoding RFCA:  %d.%d.%"PRIu64" (%d) using RFCA: %d.%d.%"PRIu64" (%d)\n",
@@ -123,16 +218,364 @@ int module_encode( rfca_opts_t opts, int argc, char** argv ) {
         double compressed = v2->ctBits + v2->encodedBits;
         printf( "Compression ratio: %f%%\n", compressed / uncompressed * 100.0 );
         
-        rfca_t* r_prime = vouw_decode( v2 );
-        rfca_print( r_prime, true );
+        rfca_t* r_prime = vouw_decodeParallel( v2, threads );
+        rfca_print( r_prime, PRINT_PRETTY );
         printf( "Correct output? %s\n", rfca_buffer_isEqual( r1->buffer, r_prime->buffer ) ? "yes" : "no" );
+        if( outPath && !encode_writeFile( v2, outPath ) )
+            retval =-1;
 
         rfca_free( r2 );
         rfca_free( r_prime );
         vouw_free( v2 );
+        if( opts2.input != opts.input )
+            free( opts2.input );
     }
     
     rfca_free( r1 );
+    if( v->log )
+        mergelog_close( v->log );
+    vouw_free( v );
+    return retval;
+}
+
+/*
+ * Read an automaton that was written by `encode --out' from a file, or - for the standard input, and print it.
+ * The automaton is decoded while the file is read. With --verify, it is compared to the automaton
+ * generated from the same options, with --quiet it is not printed.
+ */
+int
+module_decode( rfca_opts_t opts, int argc, char** argv ) {
+    (void)opts;
+    bool verify =false, quiet =false;
+    const char* path =NULL;
+    for( ; argc > 0; argv++, argc-- ) {
+        if( strcmp( argv[0], "--verify" ) == 0 )
+            verify =true;
+        else if( strcmp( argv[0], "--quiet" ) == 0 )
+            quiet =true;
+        else if( !path )
+            path = argv[0];
+        else {
+            fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+            return -1;
+        }
+    }
+    if( !path ) {
+        fprintf( stderr, "Error: Give the file to decode, or - for the standard input\n" );
+        return -1;
+    }
+
+    FILE* f = strcmp( path, "-" ) == 0 ? stdin : fopen( path, "rb" );
+    if( !f ) {
+        fprintf( stderr, "Error: Cannot open `%s'\n", path );
+        return -1;
+    }
+    uint64_t bytes;
+    const double start = encode_now();
+    rfca_t* r = codec_read( f, &bytes );
+    const double seconds = encode_now() - start;
+    if( f != stdin )
+        fclose( f );
+    if( !r )
+        return -1;
+
+    fprintf( stderr, "RFCA:  %d.%d.%"PRIu64" (%d fold)\n", r->opts.mode, r->opts.base, r->opts.rule, r->opts.folds );
+    fprintf( stderr, "Decoded %"PRIu64" bytes in %f s, %.1f MB/s\n",
+        bytes, seconds, (double)r->buffer->nodeCount / seconds / 1e6 );
+    if( !quiet )
+        rfca_print( r, PRINT_PRETTY );
+
+    int retval =0;
+    if( verify ) {
+        rfca_t* original = rfca_create( r->opts );
+        rfca_generate( original );
+        const bool equal = rfca_buffer_isEqual( original->buffer, r->buffer );
+        printf( "Correct output? %s\n", equal ? "yes" : "no" );
+        if( !equal )
+            retval =-1;
+        rfca_free( original );
+    }
+    free( r->opts.input );
+    rfca_free( r );
+    return retval;
+}
+
+
+/*
+ * Read an encoding that was written by `encode --out' from a file, or - for the standard input, and print the values
+ * of the nodes given as ROW,COL and of the windows given as ROW,COL:ROW,COL from its regions, without decoding it.
+ * With --verify, every value is compared to the automaton generated from the same options.
+ */
+int
+module_query( rfca_opts_t opts, int argc, char** argv ) {
+    (void)opts;
+    bool verify =false;
+    if( argc > 0 && strcmp( argv[0], "--verify" ) == 0 ) {
+        verify =true;
+        argv++; argc--;
+    }
+    if( argc < 2 ) {
+        fprintf( stderr, "Error: Give the encoded file, or - for the standard input, followed by the nodes to query as ROW,COL or windows as ROW,COL:ROW,COL\n" );
+        return -1;
+    }
+
+    FILE* f = strcmp( argv[0], "-" ) == 0 ? stdin : fopen( argv[0], "rb" );
+    if( !f ) {
+        fprintf( stderr, "Error: Cannot open `%s'\n", argv[0] );
+        return -1;
+    }
+    argv++; argc--;
+    rfca_t* shape;
+    vouw_t* v = codec_readEncoding( f, &shape, NULL );
+    if( f != stdin )
+        fclose( f );
+    if( !v )
+        return -1;
+    fprintf( stderr, "RFCA:  %d.%d.%"PRIu64" (%d fold)\n", shape->opts.mode, shape->opts.base, shape->opts.rule, shape->opts.folds );
+
+    // The automaton itself is only generated to verify the values
+    rfca_t* r =NULL;
+    if( verify ) {
+        r = rfca_create( shape->opts );
+        rfca_generate( r );
+    }
+
+    double start = encode_now();
+    query_index_t* q = query_index_create( v );
+    fprintf( stderr, "Indexed %"PRIu64" regions in %f s\n", q->rowStart[shape->buffer->rowCount], encode_now() - start );
+
+    char table[PRINT_TABLE_SIZE];
+    print_initDigits( table );
+    int retval =0;
+    uint64_t nodes =0, wrong =0;
+    start = encode_now();
+    for( ; argc > 0 && retval == 0; argv++, argc-- ) {
+        rfca_coord_t first, last;
+        int n =0;
+        if( sscanf( argv[0], "%d,%d%n", &first.row, &first.col, &n ) == 2 && argv[0][n] == '\0' ) {
+            rfca_node_t value;
+            if( !query_value( q, first, &value ) ) {
+                fprintf( stderr, "Error: Node %d,%d lies outside of the automaton\n", first.row, first.col );
+                retval =-1;
+                break;
+            }
+            printf( "%d,%d %c\n", first.row, first.col, table[value % PRINT_TABLE_SIZE] );
+            nodes++;
+            if( verify && value != rfca_value( r, first ) )
+                wrong++;
+        } else if( sscanf( argv[0], "%d,%d:%d,%d%n", &first.row, &first.col, &last.row, &last.col, &n ) == 4 &&
+                   argv[0][n] == '\0' && first.row <= last.row && first.col <= last.col ) {
+            const int width = last.col - first.col + 1;
+            rfca_node_t* values = (rfca_node_t*)malloc( sizeof( rfca_node_t ) * (last.row - first.row + 1) * width );
+            const uint64_t regions = query_window( q, first, last, values );
+            printf( "%s (%"PRIu64" regions)\n", argv[0], regions );
+            char* line = (char*)malloc( width + 2 );
+            for( int i =0; i <= last.row - first.row; i++ ) {
+                for( int j =0; j < width; j++ ) {
+                    const rfca_node_t value = values[i * width + j];
+                    const rfca_coord_t c = { first.row + i, first.col + j };
+                    line[j] = value == RFCA_MASKED_VALUE ? '.' : table[value % PRINT_TABLE_SIZE];
+                    if( value != RFCA_MASKED_VALUE )
+                        nodes++;
+                    if( verify && rfca_checkBounds( shape, c ) != (value != RFCA_MASKED_VALUE) )
+                        wrong++;
+                    else if( verify && value != RFCA_MASKED_VALUE && value != rfca_value( r, c ) )
+                        wrong++;
+                }
+                line[width] ='\n';
+                line[width+1] ='\0';
+                fputs( line, stdout );
+            }
+            free( line );
+            free( values );
+        } else {
+            fprintf( stderr, "Error: Queries are given as ROW,COL or ROW,COL:ROW,COL, not `%s'\n", argv[0] );
+            retval =-1;
+        }
+    }
+    fprintf( stderr, "Queried %"PRIu64" nodes in %f s\n", nodes, encode_now() - start );
+    if( verify ) {
+        printf( "Correct output? %s\n", wrong == 0 ? "yes" : "no" );
+        if( wrong )
+            retval =-1;
+    }
+
+    query_index_free( q );
     vouw_free( v );
+    if( r )
+        rfca_free( r );
+    free( shape->opts.input );
+    rfca_free( shape );
+    return retval;
+}
+
+typedef struct {
+    const rfca_t* r;
+    const rfca_coord_t* tiles;  // first and last coordinate of every tile
+    vouw_t** encoded;           // NULL for tiles without nodes
+    double* uncompressed;
+} tiles_ctx_t;
+
+static void
+tiles_encode( void* arg, uint64_t item, int worker ) {
+    (void)worker;
+    tiles_ctx_t* ctx = (tiles_ctx_t*)arg;
+    vouw_t* v = vouw_createFromWindow( ctx->r, ctx->tiles[2*item], ctx->tiles[2*item+1] );
+    if( v ) {
+        ctx->uncompressed[item] = v->ctBits + v->encodedBits;
+        vouw_encode( v );
+    }
+    ctx->encoded[item] = v;
+}
+
+/*
+ * Parse a range `FIRST-LAST' or a single index
+ */
+static bool
+tiles_parseRange( const char* spec, int* first, int* last ) {
+    int n =0;
+    if( sscanf( spec, "%d-%d%n", first, last, &n ) == 2 && spec[n] == '\0' )
+        return *first >= 0 && *first <= *last;
+    if( sscanf( spec, "%d%n", first, &n ) == 1 && spec[n] == '\0' ) {
+        *last = *first;
+        return *first >= 0;
+    }
+    return false;
 }
 
+/*
+ * Encode only a window of the automaton, or tiles of it, each with its own code table and on -j threads.
+ * The window is given by --rows FIRST-LAST and --columns FIRST-LAST and is split into tiles of
+ * --tile-size ROWS,COLS; alternatively, tiles are given one by one with --tile ROW,COL:ROW,COL.
+ * With --merge, the code tables of the tiles are combined into one, which is used to cover the entire automaton.
+ */
+int
+module_encodeTiles( rfca_opts_t opts, int argc, char** argv ) {
+    int threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    int rc;
+    int firstRow =0, lastRow = INT_MAX, firstCol =0, lastCol = INT_MAX;
+    int tileRows =0, tileCols =0;
+    bool merge =false;
+    uint64_t count =0, capacity =16;
+    rfca_coord_t* tiles = (rfca_coord_t*)malloc( sizeof( rfca_coord_t ) * 2 * capacity );
+
+    while( argc > 0 ) {
+        if( (rc = sched_parseThreads( &threads, &argv, &argc )) < 0 ) {
+            fprintf( stderr, "Error: Parameter `threads' requires a positive number\n" );
+            free( tiles );
+            return -1;
+        } else if( rc > 0 )
+            continue;
+
+        int n =0;
+        if( strcmp( argv[0], "--merge" ) == 0 ) {
+            merge =true;
+            argv++; argc--;
+            continue;
+        } else if( strcmp( argv[0], "--rows" ) == 0 && argc > 1 && tiles_parseRange( argv[1], &firstRow, &lastRow ) ) {
+        } else if( strcmp( argv[0], "--columns" ) == 0 && argc > 1 && tiles_parseRange( argv[1], &firstCol, &lastCol ) ) {
+        } else if( strcmp( argv[0], "--tile-size" ) == 0 && argc > 1 &&
+                   sscanf( argv[1], "%d,%d%n", &tileRows, &tileCols, &n ) == 2 && argv[1][n] == '\0' && tileRows > 0 && tileCols > 0 ) {
+        } else if( strcmp( argv[0], "--tile" ) == 0 && argc > 1 ) {
+            rfca_coord_t first, last;
+            if( sscanf( argv[1], "%d,%d:%d,%d%n", &first.row, &first.col, &last.row, &last.col, &n ) != 4 || argv[1][n] != '\0' ||
+                first.row < 0 || first.col < 0 || first.row > last.row || first.col > last.col ) {
+                fprintf( stderr, "Error: Tiles are given as ROW,COL:ROW,COL, not `%s'\n", argv[1] );
+                free( tiles );
+                return -1;
+            }
+            if( count == capacity ) {
+                capacity *= 2;
+                tiles = (rfca_coord_t*)realloc( tiles, sizeof( rfca_coord_t ) * 2 * capacity );
+            }
+            tiles[2*count] = first;
+            tiles[2*count+1] = last;
+            count++;
+        } else {
+            fprintf( stderr, "Error: Unknown or invalid parameter `%s'\n", argv[0] );
+            free( tiles );
+            return -1;
+        }
+        argv += 2; argc -= 2;
+    }
+
+    rfca_t* r = rfca_create( opts );
+    rfca_generate( r );
+    const rfca_buffer_t* b = r->buffer;
+    if( lastRow >= b->rowCount ) lastRow = b->rowCount - 1;
+    if( lastCol >= b->width ) lastCol = b->width - 1;
+
+    // Without explicit tiles, the window is split into tiles of the given size, or is a tile by itself
+    if( count == 0 ) {
+        if( !tileRows ) tileRows = lastRow - firstRow + 1;
+        if( !tileCols ) tileCols = lastCol - firstCol + 1;
+        for( int i = firstRow; i <= lastRow; i += tileRows ) {
+            for( int j = firstCol; j <= lastCol; j += tileCols ) {
+                if( count == capacity ) {
+                    capacity *= 2;
+                    tiles = (rfca_coord_t*)realloc( tiles, sizeof( rfca_coord_t ) * 2 * capacity );
+                }
+                rfca_coord_t first = { i, j }, last = { i + tileRows - 1, j + tileCols - 1 };
+                if( last.row > lastRow ) last.row = lastRow;
+                if( last.col > lastCol ) last.col = lastCol;
+                tiles[2*count] = first;
+                tiles[2*count+1] = last;
+                count++;
+            }
+        }
+    }
+
+    tiles_ctx_t ctx;
+    ctx.r =r;
+    ctx.tiles =tiles;
+    ctx.encoded = (vouw_t**)malloc( sizeof( vouw_t* ) * (count + 1) );
+    ctx.uncompressed = (double*)malloc( sizeof( double ) * (count + 1) );
+    double start = encode_now();
+    sched_run( 0, count, threads < (int)count ? threads : (int)(count ? count : 1), tiles_encode, NULL, &ctx );
+    fprintf( stderr, "Encoded %"PRIu64" tiles in %f s\n", count, encode_now() - start );
+
+    // Tiles without nodes are left out
+    printf( "Tile\tNodes\tPatterns\tCompression ratio\n" );
+    int encoded =0;
+    for( uint64_t t =0; t < count; t++ ) {
+        vouw_t* v = ctx.encoded[t];
+        if( !v )
+            continue;
+        int patterns =0;
+        struct list_head* pos;
+        list_for_each( pos, &(v->codeTable->list) )
+            patterns++;
+        printf( "%d,%d:%d,%d\t%d\t%d\t%f%%\n", tiles[2*t].row, tiles[2*t].col, tiles[2*t+1].row, tiles[2*t+1].col,
+            v->nodeCount, patterns, (v->ctBits + v->encodedBits) / ctx.uncompressed[t] * 100.0 );
+        ctx.encoded[encoded++] = v;
+    }
+
+    if( merge && encoded > 0 ) {
+        start = encode_now();
+        pattern_t* codeTable = vouw_mergeCodeTables( ctx.encoded, encoded );
+        vouw_t* global = vouw_createEncodedUsing( r, codeTable );
+        vouw_t* standard = vouw_createFrom( r );
+        int patterns =0, used =0;
+        struct list_head* pos;
+        list_for_each( pos, &(global->codeTable->list) ) {
+            patterns++;
+            if( list_entry( pos, pattern_t, list )->usage > 0 )
+                used++;
+        }
+        fprintf( stderr, "Merged %d code tables in %f s\n", encoded, encode_now() - start );
+        printf( "Merged code table: %d patterns, %d used\n", patterns, used );
+        printf( "Compression ratio: %f%%\n",
+            (global->ctBits + global->encodedBits) / (standard->ctBits + standard->encodedBits) * 100.0 );
+        vouw_free( standard );
+        vouw_free( global );
+        pattern_list_free( codeTable );
+    }
+
+    for( int t =0; t < encoded; t++ )
+        vouw_free( ctx.encoded[t] );
+    free( ctx.encoded );
+    free( ctx.uncompressed );
+    free( tiles );
+    rfca_free( r );
+    return 0;
+}
@@ -12,4 +12,10 @@
 
 int module_encode( rfca_opts_t opts, int argc, char** argv );
 
+int module_decode( rfca_opts_t opts, int argc, char** argv );
+
+int module_query( rfca_opts_t opts, int argc, char** argv );
+
+int module_encodeTiles( rfca_opts_t opts, int argc, char** argv );
+
 #endif
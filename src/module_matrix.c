@@ -0,0 +1,102 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "module_matrix.h"
+#include "matrix.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+
+/*
+ * Parse a range of rows or columns as FIRST-LAST or as a single index, which must be smaller than count
+ */
+static bool
+matrix_parseRange( const char* str, uint64_t count, uint64_t* first, uint64_t* last ) {
+    int n =0;
+    if( sscanf( str, "%"SCNu64"-%"SCNu64"%n", first, last, &n ) != 2 || str[n] != '\0' ) {
+        n =0;
+        if( sscanf( str, "%"SCNu64"%n", first, &n ) != 1 || str[n] != '\0' )
+            return false;
+        *last = *first;
+    }
+    return *first <= *last && *last < count;
+}
+
+/*
+ * Print the rows and columns of a matrix store that was written by distance-matrix or cluster, in the text format
+ * of distance-matrix: a line with the number of rules and the column indices, then every row preceded by its index.
+ * Without --rows and --columns the entire matrix is exported; tiles that were not written are an error.
+ */
+int
+module_matrix( rfca_opts_t opts, int argc, char** argv ) {
+    (void)opts;
+    const char* storePath =NULL;
+    const char* rows =NULL;
+    const char* columns =NULL;
+
+    while( argc > 1 ) {
+        if( strcmp( argv[0], "--store" ) == 0 )
+            storePath = argv[1];
+        else if( strcmp( argv[0], "--rows" ) == 0 )
+            rows = argv[1];
+        else if( strcmp( argv[0], "--columns" ) == 0 )
+            columns = argv[1];
+        else
+            break;
+        argv += 2; argc -= 2;
+    }
+    if( argc > 0 ) {
+        fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+        return -1;
+    }
+    if( !storePath ) {
+        fprintf( stderr, "Error: Give the matrix store with --store FILE\n" );
+        return -1;
+    }
+
+    matrix_t* m = matrix_open( storePath );
+    if( !m )
+        return -1;
+    uint64_t done =0;
+    for( uint64_t t =0; t < m->tileCount; t++ )
+        done += m->done[t] != 0;
+    fprintf( stderr, "%s: %"PRIu64" rules, %s, %"PRIu64" of %"PRIu64" tiles written\n",
+        m->header->description, m->count, m->symmetric ? "symmetric" : "asymmetric", done, m->tileCount );
+
+    uint64_t firstRow =0, lastRow = m->count - 1;
+    uint64_t firstColumn =0, lastColumn = m->count - 1;
+    if( (rows && !matrix_parseRange( rows, m->count, &firstRow, &lastRow )) ||
+        (columns && !matrix_parseRange( columns, m->count, &firstColumn, &lastColumn )) ) {
+        fprintf( stderr, "Error: Rows and columns must be given as FIRST-LAST or as an index below %"PRIu64"\n", m->count );
+        matrix_close( m );
+        return -1;
+    }
+
+    for( uint64_t ti = firstRow / m->tileSize; ti <= lastRow / m->tileSize; ti++ ) {
+        for( uint64_t tj = firstColumn / m->tileSize; tj <= lastColumn / m->tileSize; tj++ ) {
+            if( !matrix_isDone( m, m->symmetric && ti > tj ? tj : ti, m->symmetric && ti > tj ? ti : tj ) ) {
+                fprintf( stderr, "Error: The rows and columns are not all in the store, tile %"PRIu64",%"PRIu64" was not written\n", ti, tj );
+                matrix_close( m );
+                return -1;
+            }
+        }
+    }
+
+    printf( "%"PRIu64"", m->count );
+    for( uint64_t j = firstColumn; j <= lastColumn; j++ )
+        printf( "\t%"PRIu64"", j );
+    printf( "\n" );
+    for( uint64_t i = firstRow; i <= lastRow; i++ ) {
+        printf( "%"PRIu64"", i );
+        for( uint64_t j = firstColumn; j <= lastColumn; j++ )
+            printf( "\t%f", matrix_get( m, i, j ) );
+        printf( "\n" );
+    }
+
+    matrix_close( m );
+    return 0;
+}
@@ -0,0 +1,18 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef MODULE_MATRIX_H
+#define MODULE_MATRIX_H
+
+// Queries on matrix stores that are written by distance-matrix and cluster
+
+#include "rfca.h"
+
+int module_matrix( rfca_opts_t opts, int argc, char** argv );
+
+#endif
+
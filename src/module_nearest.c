@@ -0,0 +1,323 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // sysconf()
+
+#include "module_nearest.h"
+#include "vouw.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+#include "cli.h"
+#include "sched.h"
+#include "sketch.h"
+
+// Number of nearest rules that are printed by default
+#define NEAREST_K 10
+// Margin on the bound of the cross-encoded length, so that rounding never drops a candidate that is as near as the k-th
+#define NEAREST_SLACK 1e-9
+
+/* A rule that is compared to the query rule of `nearest' */
+typedef struct {
+    uint64_t rule;
+    double similarity;          // of the sketches of the code tables
+    double estimate;            // of value, from the similarity and the self-encoding of the rule
+    double value;               // cross-encoding ratio, as printed by `encode-all using'
+} nearest_candidate_t;
+
+typedef struct {
+    rfca_opts_t opts;
+    sketch_file_t* file;
+    sketch_t* sketches;         // indexed by rule
+    uint64_t* missing;          // rules that are not in the sketch file yet
+    uint64_t missingCount;
+    rfca_t** automata;          // one per worker, regenerated for every rule
+    vouw_t** encoders;          // one per worker
+    vouw_target_t** targets;    // one per worker
+    vouw_scratch_t** scratch;   // one per worker
+    const vouw_t* query;
+    nearest_candidate_t* candidates; // by ascending estimate
+    nearest_candidate_t* best;  // the nearest rules found so far, by ascending value
+    int k, found;
+    uint64_t abandoned;         // cross-encodings that were given up early
+    pthread_mutex_t lock;       // protects best, found and abandoned
+} nearest_ctx_t;
+
+/*
+ * Generate rule on the automaton of the given worker
+ */
+static rfca_t*
+nearest_generate( nearest_ctx_t* ctx, int worker, uint64_t rule ) {
+    rfca_t* r = ctx->automata[worker];
+    if( r )
+        rfca_reset( r, rule );
+    else {
+        rfca_opts_t opts = ctx->opts;
+        opts.rule = rule;
+        r = ctx->automata[worker] = rfca_create( opts );
+    }
+    rfca_generate( r );
+    return r;
+}
+
+/*
+ * Self-encode a rule that is not in the sketch file and add its sketch
+ */
+static void
+nearest_sketch( void* arg, uint64_t i, int worker ) {
+    nearest_ctx_t* ctx = (nearest_ctx_t*)arg;
+    const uint64_t rule = ctx->missing[i];
+    rfca_t* r = nearest_generate( ctx, worker, rule );
+
+    vouw_t* v = ctx->encoders[worker];
+    if( v )
+        vouw_reset( v, r );
+    else {
+        v = ctx->encoders[worker] = vouw_createFrom( r );
+        v->keepBuffer =true;
+    }
+    const double uncompressed = v->ctBits + v->encodedBits;
+    vouw_encode( v );
+    sketch_compute( &ctx->sketches[rule], rule, uncompressed, v->ctBits + v->encodedBits, v->codeTable );
+    sketch_file_append( ctx->file, &ctx->sketches[rule] );
+}
+
+static void
+nearest_notify( void* arg, uint64_t done ) {
+    const nearest_ctx_t* ctx = (const nearest_ctx_t*)arg;
+    fprintf( stderr, "\rSketched %"PRIu64" of %"PRIu64" rules (%.1f%%)",
+        done, ctx->missingCount, (double)done/(double)ctx->missingCount * 100.0 );
+}
+
+static bool
+nearest_isBefore( const nearest_candidate_t* a, const nearest_candidate_t* b ) {
+    return a->value < b->value || (a->value == b->value && a->rule < b->rule);
+}
+
+static int
+nearest_cmpEstimate( const void* a, const void* b ) {
+    const nearest_candidate_t* ca = (const nearest_candidate_t*)a;
+    const nearest_candidate_t* cb = (const nearest_candidate_t*)b;
+    if( ca->estimate != cb->estimate )
+        return ca->estimate < cb->estimate ? -1 : 1;
+    return ca->rule < cb->rule ? -1 : ca->rule > cb->rule;
+}
+
+/*
+ * Cross-encode a candidate with the code table of the query rule.
+ * The cover is given up once the rule cannot be nearer than the k-th nearest rule found so far.
+ */
+static void
+nearest_crossEncode( void* arg, uint64_t i, int worker ) {
+    nearest_ctx_t* ctx = (nearest_ctx_t*)arg;
+    nearest_candidate_t* c = &ctx->candidates[i];
+    const double compressed = ctx->sketches[c->rule].compressed;
+
+    double bound = INFINITY;
+    pthread_mutex_lock( &ctx->lock );
+    if( ctx->found == ctx->k )
+        bound = compressed * (1.0 + ctx->best[ctx->k-1].value) * (1.0 + NEAREST_SLACK);
+    pthread_mutex_unlock( &ctx->lock );
+
+    rfca_t* r = nearest_generate( ctx, worker, c->rule );
+    vouw_target_t* t = ctx->targets[worker];
+    if( t )
+        vouw_target_reset( t, r );
+    else
+        t = ctx->targets[worker] = vouw_target_create( r );
+    const double compressed_using =
+        vouw_crossEncodedLengthBounded( t, ctx->query->codeTable, ctx->scratch[worker], bound, NULL, NULL );
+
+    pthread_mutex_lock( &ctx->lock );
+    if( compressed_using == INFINITY )
+        ctx->abandoned++;
+    else {
+        c->value = (compressed_using - compressed) / compressed;
+        // Insert into the k nearest so far, if it is nearer than the last one
+        int j = ctx->found;
+        if( j == ctx->k && !nearest_isBefore( c, &ctx->best[j-1] ) )
+            j = -1;
+        else if( j == ctx->k )
+            j--;
+        else
+            ctx->found++;
+        for( ; j > 0 && nearest_isBefore( c, &ctx->best[j-1] ); j-- )
+            ctx->best[j] = ctx->best[j-1];
+        if( j >= 0 )
+            ctx->best[j] = *c;
+    }
+    pthread_mutex_unlock( &ctx->lock );
+}
+
+/*
+ * Find the rules of the class nearest to the rule given by -r, measured as in `encode-all using':
+ * by how much longer a rule gets when it is encoded with the code table of the query rule.
+ * Every rule is self-encoded once and summarized by its encoded lengths and a MinHash sketch of
+ * its code table, which are stored in the sketch file so that later queries only encode the query rule.
+ * The rules are then cross-encoded in order of the distance estimated from their sketches, so that
+ * cross-encodings of rules that cannot be among the nearest are given up early. With a shortlist,
+ * only that many rules with the smallest estimates are cross-encoded and the result is approximate.
+ */
+int
+module_nearest( rfca_opts_t opts, int argc, char** argv ) {
+    uint64_t rulespace = rfca_maxRules( opts.base, opts.mode );
+    int threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    int rc, k =NEAREST_K;
+    uint64_t shortlist =0;
+    const char* sketchPath =NULL;
+
+    if( !cli_checkGenerated( &opts ) )
+        return -1;
+
+    while( argc > 0 ) {
+        if( (rc = sched_parseThreads( &threads, &argv, &argc )) < 0 ) {
+            fprintf( stderr, "Error: Parameter `threads' requires a positive number\n" );
+            return -1;
+        } else if( rc > 0 )
+            continue;
+        if( argc < 2 ) {
+            fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+            return -1;
+        }
+        if( strcmp( argv[0], "-k" ) == 0 ) {
+            if( (k = atoi( argv[1] )) < 1 ) {
+                fprintf( stderr, "Error: Parameter `k' requires a positive number\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--shortlist" ) == 0 ) {
+            if( sscanf( argv[1], "%"SCNu64, &shortlist ) != 1 || shortlist == 0 ) {
+                fprintf( stderr, "Error: Parameter `shortlist' requires a positive number\n" );
+                return -1;
+            }
+        } else if( strcmp( argv[0], "--sketches" ) == 0 ) {
+            sketchPath = argv[1];
+        } else {
+            fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+            return -1;
+        }
+        argv += 2; argc -= 2;
+    }
+    if( !sketchPath ) {
+        fprintf( stderr, "Error: Parameter `sketches' is required\n" );
+        return -1;
+    }
+    if( threads < 1 )
+        threads =1;
+    if( !shortlist || shortlist > rulespace - 1 )
+        shortlist = rulespace - 1;
+    if( (uint64_t)k > shortlist )
+        k = (int)shortlist;
+
+    // The sketches describe the class, not the query rule
+    char header[SKETCH_HEADER_MAX];
+    rfca_opts_t classOpts = opts;
+    classOpts.rule =0;
+    int n = snprintf( header, sizeof( header ), "vouw sketches " );
+    cli_formatOpts( header + n, sizeof( header ) - n, &classOpts );
+
+    nearest_ctx_t ctx;
+    ctx.file = sketch_file_open( sketchPath, header );
+    if( !ctx.file )
+        return -1;
+    ctx.opts =opts;
+    ctx.sketches = (sketch_t*)malloc( sizeof( sketch_t ) * rulespace );
+    ctx.missing = (uint64_t*)malloc( sizeof( uint64_t ) * rulespace );
+    ctx.missingCount =0;
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        const sketch_t* s = sketch_file_find( ctx.file, i );
+        if( s )
+            ctx.sketches[i] = *s;
+        else
+            ctx.missing[ctx.missingCount++] = i;
+    }
+    rfca_t* automata[threads];
+    vouw_t* encoders[threads];
+    vouw_target_t* targets[threads];
+    vouw_scratch_t* scratch[threads];
+    for( int i =0; i < threads; i++ ) {
+        automata[i] =NULL;
+        encoders[i] =NULL;
+        targets[i] =NULL;
+        scratch[i] = vouw_scratch_create();
+    }
+    ctx.automata =automata;
+    ctx.encoders =encoders;
+    ctx.targets =targets;
+    ctx.scratch =scratch;
+
+    if( ctx.missingCount ) {
+        fprintf( stderr, "Sketching %"PRIu64" of %"PRIu64" rules of RFCA class %d.%d on %d threads\n",
+            ctx.missingCount, rulespace, opts.mode, opts.base, threads );
+        sched_run( 0, ctx.missingCount, threads, nearest_sketch, nearest_notify, &ctx );
+        fprintf( stderr, "\n" );
+    }
+    for( int i =0; i < threads; i++ ) {
+        if( encoders[i] )
+            vouw_free( encoders[i] );
+        encoders[i] =NULL;
+    }
+
+    // The query rule is encoded again, its code table is needed for the cross-encodings
+    rfca_t* r = rfca_create( opts );
+    rfca_generate( r );
+    vouw_t* query = vouw_createFrom( r );
+    const double uncompressed = query->ctBits + query->encodedBits;
+    vouw_encode( query );
+    sketch_t querySketch;
+    sketch_compute( &querySketch, opts.rule, uncompressed, query->ctBits + query->encodedBits, query->codeTable );
+    ctx.query =query;
+
+    // The code table of the query rule is assumed to recover the share of the compression of a rule
+    // that equals the similarity of their code tables. Rules that compress poorly by themselves are
+    // thereby expected to be near as well, which they often are.
+    ctx.candidates = (nearest_candidate_t*)malloc( sizeof( nearest_candidate_t ) * (rulespace - 1) );
+    uint64_t count =0;
+    for( uint64_t i =0; i < rulespace; i++ ) {
+        if( i == opts.rule )
+            continue;
+        const sketch_t* s = &ctx.sketches[i];
+        nearest_candidate_t* c = &ctx.candidates[count++];
+        c->rule = i;
+        c->similarity = sketch_similarity( &querySketch, s );
+        c->estimate = (1.0 - c->similarity) * (s->uncompressed - s->compressed) / s->compressed;
+        c->value =0.0;
+    }
+    qsort( ctx.candidates, count, sizeof( nearest_candidate_t ), nearest_cmpEstimate );
+
+    ctx.k =k;
+    ctx.found =0;
+    ctx.abandoned =0;
+    ctx.best = (nearest_candidate_t*)malloc( sizeof( nearest_candidate_t ) * k );
+    pthread_mutex_init( &ctx.lock, NULL );
+    sched_run( 0, shortlist, threads, nearest_crossEncode, NULL, &ctx );
+    pthread_mutex_destroy( &ctx.lock );
+
+    fprintf( stderr, "Cross-encoded %"PRIu64" of %"PRIu64" rules with the code table of rule %"PRIu64", %"PRIu64" given up early\n",
+        shortlist, rulespace - 1, opts.rule, ctx.abandoned );
+    for( int i =0; i < ctx.found; i++ )
+        printf( "%"PRIu64"\t%f\t%.3f\n", ctx.best[i].rule, ctx.best[i].value, ctx.best[i].similarity );
+
+    for( int i =0; i < threads; i++ ) {
+        if( automata[i] )
+            rfca_free( automata[i] );
+        if( targets[i] )
+            vouw_target_free( targets[i] );
+        vouw_scratch_free( scratch[i] );
+    }
+    vouw_free( query );
+    rfca_free( r );
+    sketch_file_close( ctx.file );
+    free( ctx.sketches );
+    free( ctx.missing );
+    free( ctx.candidates );
+    free( ctx.best );
+    return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org> 
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef MODULE_NEAREST_H
+#define MODULE_NEAREST_H
+
+// Finds the rules of a rulespace that are nearest to a given rule
+
+#include "rfca.h"
+
+int module_nearest( rfca_opts_t opts, int argc, char** argv );
+
+#endif
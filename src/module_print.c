@@ -5,37 +5,121 @@
  * Leiden Institute for Advanced Computer Science
  */
 
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+
 #include "module_print.h"
 #include "ttable.h"
+#include "dataset.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+/*
+ * Fill in the character of every node value of an automaton
+ */
 void
-rfca_print( rfca_t* r, bool pretty ) {
-    for( int i =0; i < r->buffer->rowCount; i++ ) {
-        if( pretty ) {
-            for( int k =0; k < i * (r->opts.mode-1); k++ )
-                fprintf( stdout, " " );
+print_initDigits( char table[PRINT_TABLE_SIZE] ) {
+    for( int v =0; v < PRINT_TABLE_SIZE; v++ )
+        table[v] = v < 10 ? (char)('0' + v) : (char)('a' + v - 10);
+}
+
+/*
+ * Print the nodes of a buffer row by row, converting each value with table.
+ * Every row is formatted into a line buffer and written at once. If mirrored is set,
+ * the nodes of each row are printed from last to first, as rfca_value() returns them.
+ * With PRINT_RAW, the node values themselves are written as bytes and the table is not used.
+ */
+void
+print_buffer( FILE* f, const rfca_buffer_t* b, bool mirrored, const char table[PRINT_TABLE_SIZE], print_style_t style ) {
+    size_t capacity =0;
+    char* line =NULL;
+
+    for( int i =0; i < b->rowCount; i++ ) {
+        const rfca_row_t* row = &b->rows[i];
+        const int indent = style == PRINT_PRETTY ? i * (b->mode-1) : 0;
+        const size_t length = indent + (style == PRINT_PRETTY ? 2 : 1) * (size_t)row->size + (style == PRINT_RAW ? 0 : 1);
+        if( length > capacity ) {
+            capacity = length * 2;
+            line = (char*)realloc( line, capacity );
         }
-        for( int j =0; j < rfca_rowLength( r, i ); j++ ) {
-            rfca_coord_t c = {i, j};
-            fprintf( stdout, "%d", (int)rfca_value( r, c ) );
-            if( pretty ) fprintf( stdout, " " );
+
+        char* out = line;
+        memset( out, ' ', indent );
+        out += indent;
+        for( int j =0; j < row->size; j++ ) {
+            const uint8_t value = (uint8_t)row->cols[mirrored ? row->size - 1 - j : j];
+            if( style == PRINT_RAW ) {
+                *out++ = (char)value;
+                continue;
+            }
+            *out++ = table[value];
+            if( style == PRINT_PRETTY )
+                *out++ = ' ';
         }
-        fprintf( stdout, "\n" );
+        if( style != PRINT_RAW )
+            *out++ = '\n';
+        fwrite( line, 1, out - line, f );
     }
+    free( line );
 }
 
+void
+rfca_print( rfca_t* r, print_style_t style ) {
+    char table[PRINT_TABLE_SIZE];
+    print_initDigits( table );
+    print_buffer( stdout, r->buffer, !r->opts.right, table, style );
+}
+
+/*
+ * Print the automaton given by the options. With --plain, nodes are not separated and rows are not indented,
+ * with --raw the node values are written as bytes, row after row without line breaks.
+ */
 int 
 module_print( rfca_opts_t opts, int argc, char** argv ) {
+    print_style_t style =PRINT_PRETTY;
+    if( argc > 0 && strcmp( argv[0], "--plain" ) == 0 )
+        style =PRINT_PLAIN;
+    else if( argc > 0 && strcmp( argv[0], "--raw" ) == 0 )
+        style =PRINT_RAW;
+    else if( argc > 0 ) {
+        fprintf( stderr, "Error: Unknown parameter `%s'\n", argv[0] );
+        return -1;
+    }
 
     rfca_t* r = rfca_create( opts );
     rfca_generate( r );
-    rfca_print( r, true );
+    rfca_print( r, style );
     rfca_free( r );
     return 0;
 }
 
+/*
+ * Generate the automaton and write it to the given file, which can be read back
+ * with --from-file instead of generating the automaton again
+ */
+int
+module_generate( rfca_opts_t opts, int argc, char** argv ) {
+    if( argc != 1 ) {
+        fprintf( stderr, "Error: Give the file to write the automaton to\n" );
+        return -1;
+    }
+    struct timespec t0, t1, t2;
+    clock_gettime( CLOCK_MONOTONIC, &t0 );
+    rfca_t* r = rfca_create( opts );
+    rfca_generate( r );
+    clock_gettime( CLOCK_MONOTONIC, &t1 );
+    const bool ok = dataset_write( r, argv[0] );
+    clock_gettime( CLOCK_MONOTONIC, &t2 );
+    if( ok )
+        fprintf( stderr, "Generated %d nodes in %f s, wrote them to `%s' in %f s\n", r->buffer->nodeCount,
+            (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9, argv[0],
+            (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) * 1e-9 );
+    rfca_free( r );
+    return ok ? 0 : -1;
+}
+
 void
 ttable_print( ttable_t* tt ) {
     for( int i =0; i < tt->size; i++ ) {
@@ -9,12 +9,30 @@
 #define MODULE_PRINT_H
 
 #include "rfca.h"
+#include <stdio.h>
+
+// Number of node values that are converted by a table, node values are printed modulo this size
+#define PRINT_TABLE_SIZE 256
+
+typedef enum {
+    PRINT_PRETTY,   // rows are indented to show the structure and nodes are separated by spaces
+    PRINT_PLAIN,    // one character per node, one row per line
+    PRINT_RAW       // one byte per node holding its value, no line breaks
+} print_style_t;
+
+void
+print_initDigits( char table[PRINT_TABLE_SIZE] );
 
 void
-rfca_print( rfca_t* r, bool pretty );
+print_buffer( FILE* f, const rfca_buffer_t* b, bool mirrored, const char table[PRINT_TABLE_SIZE], print_style_t style );
+
+void
+rfca_print( rfca_t* r, print_style_t style );
 
 int module_print( rfca_opts_t opts, int argc, char** argv );
 
+int module_generate( rfca_opts_t opts, int argc, char** argv );
+
 int module_printTTable( rfca_opts_t opts, int argc, char** argv );
 int module_printTTable2( rfca_opts_t opts, int argc, char** argv );
 
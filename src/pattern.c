@@ -8,9 +8,44 @@
 #include "pattern.h"
 #include "list_sort.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 //#define BLOCKSIZE 16
 
+#define PATTERN_HASH_INIT 14695981039346656037ULL
+
+/* One step of 64-bit FNV-1a over the (row, col, value) triple of o */
+static uint64_t
+pattern_hashOffset( uint64_t h, pattern_offset_t o ) {
+    int64_t fields[3] = { o.row, o.col, (int64_t)o.value };
+    const unsigned char* bytes = (const unsigned char*)fields;
+    for( unsigned int j =0; j < sizeof( fields ); j++ ) {
+        h ^= bytes[j];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* 64-bit FNV-1a over the (row, col, value) triples of p, in offset order */
+static uint64_t
+pattern_hash( const pattern_t* p ) {
+    uint64_t h = PATTERN_HASH_INIT;
+    for( unsigned int i =0; i < p->size; i++ )
+        h = pattern_hashOffset( h, p->offsets[i] );
+    return h;
+}
+
+static int
+pattern_cmp_offset( const void* a, const void* b ) {
+    const pattern_offset_t* oa = (const pattern_offset_t*)a;
+    const pattern_offset_t* ob = (const pattern_offset_t*)b;
+    if( oa->row != ob->row )
+        return oa->row < ob->row ? -1 : 1;
+    if( oa->col != ob->col )
+        return oa->col < ob->col ? -1 : 1;
+    return 0;
+}
+
 rfca_coord_t
 pattern_offset_abs( rfca_coord_t c, pattern_offset_t offs ) {
     rfca_coord_t c2 = { c.row + offs.row, c.col + offs.col };
@@ -26,6 +61,24 @@ pattern_offset( rfca_coord_t pivot1, rfca_coord_t pivot2 ) {
     return o;
 }
 
+/*
+ * Create a pattern with a copy of size offsets, which must be in canonical form (see pattern_canonicalize())
+ */
+pattern_t*
+pattern_create( const pattern_offset_t* offsets, unsigned int size ) {
+    pattern_t* p = (pattern_t*)malloc( sizeof( pattern_t ) );
+
+    p->size =size;
+    p->usage =0;
+    p->codeLength = 0.0;
+    p->offsets = (pattern_offset_t*)malloc( size * sizeof( pattern_offset_t ) );
+    memcpy( p->offsets, offsets, size * sizeof( pattern_offset_t ) );
+    p->hash = pattern_hash( p );
+    INIT_LIST_HEAD( &(p->list) );
+
+    return p;
+}
+
 pattern_t*
 pattern_createSingle( int value ) {
     pattern_t* p = (pattern_t*)malloc( sizeof( pattern_t ) );
@@ -37,6 +90,7 @@ pattern_createSingle( int value ) {
     p->offsets[0].row =0;
     p->offsets[0].col =0;
     p->offsets[0].value = value;
+    p->hash = pattern_hash( p );
     INIT_LIST_HEAD( &(p->list) );
 
     return p;
@@ -93,6 +147,7 @@ pattern_createCopy( const pattern_t* src ) {
     p->usage =src->usage;
     p->label =src->label;
     p->codeLength =src->codeLength;
+    p->hash =src->hash;
     p->offsets = (pattern_offset_t*)malloc( p->size * sizeof( pattern_offset_t ) );
     
     for( int i=0; i < src->size; i++ )
@@ -103,6 +158,45 @@ pattern_createCopy( const pattern_t* src ) {
     return p;
 }
 
+/*
+ * Bring p into its canonical form: offsets sorted by row, then col,
+ * translated such that the first offset is {0,0} and its values shifted (modulo base)
+ * such that the first offset has value 0. Two patterns that describe the same shape
+ * are equal after canonicalization, regardless of how they were constructed.
+ * Returns the removed translation and value shift: a region with pivot c and variant v
+ * is equal to a region on the canonical pattern with pivot c + {row,col} and variant v + value.
+ */
+pattern_offset_t
+pattern_canonicalize( pattern_t* p, int base ) {
+    qsort( p->offsets, p->size, sizeof( pattern_offset_t ), pattern_cmp_offset );
+
+    pattern_offset_t anchor = p->offsets[0];
+    for( unsigned int i =0; i < p->size; i++ ) {
+        p->offsets[i].row -= anchor.row;
+        p->offsets[i].col -= anchor.col;
+        p->offsets[i].value = ((p->offsets[i].value + base) - anchor.value) % base;
+    }
+    p->hash = pattern_hash( p );
+    return anchor;
+}
+
+/*
+ * Returns true if p1 and p2 have identical offsets and values.
+ * Both are assumed to be in canonical form
+ */
+bool
+pattern_isEqual( const pattern_t* p1, const pattern_t* p2 ) {
+    if( p1->size != p2->size || p1->hash != p2->hash )
+        return false;
+    for( unsigned int i =0; i < p1->size; i++ ) {
+        if( p1->offsets[i].row != p2->offsets[i].row ||
+            p1->offsets[i].col != p2->offsets[i].col ||
+            p1->offsets[i].value != p2->offsets[i].value )
+            return false;
+    }
+    return true;
+}
+
 void
 pattern_free( pattern_t* p ) {
     free( p->offsets );
@@ -156,7 +250,7 @@ pattern_isMatch( const pattern_t* p, const rfca_t* r, rfca_coord_t pivot, int* v
         }
         else {
             // Check match
-            if( p->offsets[i].value != ( rfca_value( r, c ) + v ) % base )
+            if( ( p->offsets[i].value + v ) % base != rfca_value( r, c ) )
                 return false;
 /*            v2 = (rfca_value( r, c ) -  p->offsets[i].value) % base;
             v2 = v2 < 0 ? v2+base : v2;
@@ -195,6 +289,28 @@ pattern_computeBounds( const pattern_t* p ) {
     return pb;
 }
 
+/*
+ * Compute the range of pivots [first,last] on `row' for which all offsets of p
+ * lie within an automaton with the given row sizes. Returns false if no such pivot exists.
+ */
+bool
+pattern_rowBounds( const pattern_t* p, const int* rowSize, int rowCount, int row, int* first, int* last ) {
+    int lo =0, hi =rowSize[row]-1;
+    for( unsigned int k =0; k < p->size; k++ ) {
+        const pattern_offset_t* o = &p->offsets[k];
+        const int r = row + o->row;
+        if( r < 0 || r >= rowCount )
+            return false;
+        if( -o->col > lo )
+            lo = -o->col;
+        if( rowSize[r]-1 - o->col < hi )
+            hi = rowSize[r]-1 - o->col;
+    }
+    *first = lo;
+    *last = hi;
+    return lo <= hi;
+}
+
 /*
  * Use pattern p to change multiple nodes of b to value.
  * pivot is used to compute absolute coordinates from each offset in p.
@@ -236,6 +352,36 @@ pattern_list_setLabels( pattern_t* list ) {
     }
 }
 
+/*
+ * Number the patterns in list by their position, returns the number of patterns
+ */
+int
+pattern_list_setIndices( pattern_t* list ) {
+    struct list_head* pos;
+    int i =0;
+    list_for_each( pos, &(list->list) ) {
+        pattern_t* pattern = list_entry( pos, pattern_t, list );
+        pattern->index =i++;
+    }
+    return i;
+}
+
+/*
+ * Digest of a code table: the hashes and usages of its patterns in list order.
+ * Two encodings that end with the same code table have the same digest.
+ */
+uint64_t
+pattern_list_digest( pattern_t* list ) {
+    uint64_t h = 14695981039346656037ULL;
+    struct list_head* pos;
+    list_for_each( pos, &(list->list) ) {
+        const pattern_t* pattern = list_entry( pos, pattern_t, list );
+        h = (h ^ pattern->hash) * 1099511628211ULL;
+        h = (h ^ pattern->usage) * 1099511628211ULL;
+    }
+    return h;
+}
+
 double
 pattern_list_updateCodeLength( pattern_t* list, unsigned int totalNodeCount ) {
     struct list_head* pos;
@@ -285,3 +431,169 @@ void
 pattern_list_sortBySizeDesc( pattern_t* head ) {
     list_sort( NULL, &(head->list), pattern_cmp_size );
 }
+
+//
+// Pattern index (intern table) below
+//
+
+pattern_index_t*
+pattern_index_create( unsigned int capacity ) {
+    pattern_index_t* idx = (pattern_index_t*)malloc( sizeof( pattern_index_t ) );
+    idx->capacity =16;
+    while( idx->capacity < capacity * 2 )
+        idx->capacity <<= 1;
+    idx->count =0;
+    idx->slots = (pattern_t**)calloc( idx->capacity, sizeof( pattern_t* ) );
+    return idx;
+}
+
+/*
+ * Remove all patterns from idx, its capacity is kept
+ */
+void
+pattern_index_clear( pattern_index_t* idx ) {
+    memset( idx->slots, 0, sizeof( pattern_t* ) * idx->capacity );
+    idx->count =0;
+}
+
+void
+pattern_index_free( pattern_index_t* idx ) {
+    free( idx->slots );
+    free( idx );
+}
+
+/*
+ * Returns the pattern in idx that is equal to p, or NULL if there is none
+ */
+pattern_t*
+pattern_index_find( const pattern_index_t* idx, const pattern_t* p ) {
+    const unsigned int mask = idx->capacity - 1;
+    for( unsigned int i = p->hash & mask; idx->slots[i]; i = (i+1) & mask ) {
+        if( pattern_isEqual( idx->slots[i], p ) )
+            return idx->slots[i];
+    }
+    return NULL;
+}
+
+/*
+ * Returns the next offset of the union of p1 and p2, as pattern_createVariantUnion() would create it,
+ * in the order of the canonical form. i and j count the offsets of p1 and p2 that were returned before.
+ */
+static pattern_offset_t
+pattern_unionNext( const pattern_t* p1, const pattern_t* p2, int variant, pattern_offset_t p2_offset, int base,
+                   unsigned int* i, unsigned int* j ) {
+    if( *j < p2->size ) {
+        pattern_offset_t o = p2->offsets[*j];
+        o.row += p2_offset.row;
+        o.col += p2_offset.col;
+        o.value = (o.value + variant) % base;
+        if( *i == p1->size || pattern_cmp_offset( &o, &p1->offsets[*i] ) < 0 ) {
+            (*j)++;
+            return o;
+        }
+    }
+    return p1->offsets[(*i)++];
+}
+
+/*
+ * Returns the pattern in idx that is equal to the canonical form of the union of p1 and p2,
+ * or NULL if there is none. This gives the same as looking up the canonicalized result of
+ * pattern_createVariantUnion(), but the union is never built: p1 and p2 are in canonical form,
+ * so their offsets are sorted and the union is hashed and compared while they are merged.
+ */
+pattern_t*
+pattern_index_findUnion( const pattern_index_t* idx, const pattern_t* p1, const pattern_t* p2,
+                         int variant, pattern_offset_t p2_offset, int base ) {
+    const unsigned int size = p1->size + p2->size;
+    unsigned int i =0, j =0;
+    const pattern_offset_t anchor = pattern_unionNext( p1, p2, variant, p2_offset, base, &i, &j );
+
+    uint64_t h = PATTERN_HASH_INIT;
+    i = j =0;
+    for( unsigned int k =0; k < size; k++ ) {
+        pattern_offset_t o = pattern_unionNext( p1, p2, variant, p2_offset, base, &i, &j );
+        o.row -= anchor.row;
+        o.col -= anchor.col;
+        o.value = ((o.value + base) - anchor.value) % base;
+        h = pattern_hashOffset( h, o );
+    }
+
+    const unsigned int mask = idx->capacity - 1;
+    for( unsigned int s = h & mask; idx->slots[s]; s = (s+1) & mask ) {
+        const pattern_t* q = idx->slots[s];
+        if( q->size != size || q->hash != h )
+            continue;
+        unsigned int k;
+        i = j =0;
+        for( k =0; k < size; k++ ) {
+            const pattern_offset_t o = pattern_unionNext( p1, p2, variant, p2_offset, base, &i, &j );
+            if( q->offsets[k].row != o.row - anchor.row || q->offsets[k].col != o.col - anchor.col ||
+                q->offsets[k].value != ((o.value + base) - anchor.value) % base )
+                break;
+        }
+        if( k == size )
+            return idx->slots[s];
+    }
+    return NULL;
+}
+
+static void
+pattern_index_grow( pattern_index_t* idx ) {
+    pattern_t** old = idx->slots;
+    unsigned int oldCapacity = idx->capacity;
+
+    idx->capacity <<= 1;
+    idx->count =0;
+    idx->slots = (pattern_t**)calloc( idx->capacity, sizeof( pattern_t* ) );
+    for( unsigned int i =0; i < oldCapacity; i++ ) {
+        if( old[i] )
+            pattern_index_insert( idx, old[i] );
+    }
+    free( old );
+}
+
+/*
+ * Add p to idx. The caller should make sure that no equal pattern is present yet.
+ */
+void
+pattern_index_insert( pattern_index_t* idx, pattern_t* p ) {
+    // Keep the load factor below one half
+    if( (idx->count+1) * 2 > idx->capacity )
+        pattern_index_grow( idx );
+
+    const unsigned int mask = idx->capacity - 1;
+    unsigned int i = p->hash & mask;
+    while( idx->slots[i] )
+        i = (i+1) & mask;
+    idx->slots[i] = p;
+    idx->count++;
+}
+
+/*
+ * Remove the exact pattern object p from idx, if present
+ */
+void
+pattern_index_remove( pattern_index_t* idx, const pattern_t* p ) {
+    const unsigned int mask = idx->capacity - 1;
+    unsigned int i = p->hash & mask;
+    while( idx->slots[i] && idx->slots[i] != p )
+        i = (i+1) & mask;
+    if( !idx->slots[i] )
+        return;
+
+    // Backward-shift deletion keeps all probe sequences intact without tombstones
+    unsigned int j = i;
+    for( ;; ) {
+        j = (j+1) & mask;
+        if( !idx->slots[j] )
+            break;
+        unsigned int home = idx->slots[j]->hash & mask;
+        // Move slot j into the hole at i if its home position does not lie in (i,j]
+        if( ((j - home) & mask) >= ((j - i) & mask) ) {
+            idx->slots[i] = idx->slots[j];
+            i = j;
+        }
+    }
+    idx->slots[i] = NULL;
+    idx->count--;
+}
@@ -30,9 +30,20 @@ typedef struct {
     unsigned int usage;
     unsigned int size;
     double codeLength;
+    uint64_t hash; // hash of the canonical form, see pattern_canonicalize()
+    int index; // position in the code table, see pattern_list_setIndices()
     char label; // for debug printing
 } pattern_t;
 
+/* Open-addressing hash table used to intern patterns by their canonical form.
+ * The table does not own the patterns it holds.
+ */
+typedef struct {
+    pattern_t** slots;
+    unsigned int capacity; // always a power of two
+    unsigned int count;
+} pattern_index_t;
+
 typedef struct {
     int rowMin;
     int rowMax;
@@ -40,6 +51,9 @@ typedef struct {
     int colMax;
 } pattern_bounds_t;
 
+pattern_t*
+pattern_create( const pattern_offset_t* offsets, unsigned int size );
+
 pattern_t*
 pattern_createSingle( int value );
 
@@ -52,6 +66,12 @@ pattern_createVariantUnion( const pattern_t* p1, const pattern_t* p2, int varian
 pattern_t*
 pattern_createCopy( const pattern_t* src );
 
+pattern_offset_t
+pattern_canonicalize( pattern_t* p, int base );
+
+bool
+pattern_isEqual( const pattern_t* p1, const pattern_t* p2 );
+
 void
 pattern_free( pattern_t* p );
 
@@ -67,6 +87,9 @@ pattern_isMatch( const pattern_t* p, const rfca_t* r, rfca_coord_t pivot, int* v
 pattern_bounds_t
 pattern_computeBounds( const pattern_t* p );
 
+bool
+pattern_rowBounds( const pattern_t* p, const int* rowSize, int rowCount, int row, int* first, int* last );
+
 void
 pattern_setBufferValues( const pattern_t* p, rfca_coord_t pivot, rfca_buffer_t* b, rfca_node_t value );
 
@@ -76,6 +99,12 @@ pattern_list_free( pattern_t* list );
 void 
 pattern_list_setLabels( pattern_t* list );
 
+int
+pattern_list_setIndices( pattern_t* list );
+
+uint64_t
+pattern_list_digest( pattern_t* list );
+
 double
 pattern_list_updateCodeLength( pattern_t* list, unsigned int totalNodeCount );
 
@@ -85,4 +114,26 @@ pattern_list_sortByUsageDesc( pattern_t* head );
 void
 pattern_list_sortBySizeDesc( pattern_t* head );
 
+pattern_index_t*
+pattern_index_create( unsigned int capacity );
+
+void
+pattern_index_clear( pattern_index_t* idx );
+
+void
+pattern_index_free( pattern_index_t* idx );
+
+pattern_t*
+pattern_index_find( const pattern_index_t* idx, const pattern_t* p );
+
+pattern_t*
+pattern_index_findUnion( const pattern_index_t* idx, const pattern_t* p1, const pattern_t* p2,
+                         int variant, pattern_offset_t p2_offset, int base );
+
+void
+pattern_index_insert( pattern_index_t* idx, pattern_t* p );
+
+void
+pattern_index_remove( pattern_index_t* idx, const pattern_t* p );
+
 #endif
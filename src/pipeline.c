@@ -0,0 +1,158 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "pipeline.h"
+#include <stdlib.h>
+
+void
+pipeline_queue_init( pipeline_queue_t* q, int capacity, int producers ) {
+    q->items = (void**)malloc( sizeof( void* ) * capacity );
+    q->capacity =capacity;
+    q->head =0;
+    q->count =0;
+    q->producers =producers;
+    pthread_mutex_init( &q->lock, NULL );
+    pthread_cond_init( &q->notEmpty, NULL );
+    pthread_cond_init( &q->notFull, NULL );
+}
+
+void
+pipeline_queue_destroy( pipeline_queue_t* q ) {
+    pthread_mutex_destroy( &q->lock );
+    pthread_cond_destroy( &q->notEmpty );
+    pthread_cond_destroy( &q->notFull );
+    free( q->items );
+}
+
+/*
+ * Append an item, waits while the queue is full
+ */
+void
+pipeline_queue_push( pipeline_queue_t* q, void* item ) {
+    pthread_mutex_lock( &q->lock );
+    while( q->count == q->capacity )
+        pthread_cond_wait( &q->notFull, &q->lock );
+    q->items[(q->head + q->count) % q->capacity] = item;
+    q->count++;
+    pthread_cond_signal( &q->notEmpty );
+    pthread_mutex_unlock( &q->lock );
+}
+
+/*
+ * Take the oldest item, waits while the queue is empty.
+ * Returns NULL if the queue is empty and all producers have closed it.
+ */
+void*
+pipeline_queue_pop( pipeline_queue_t* q ) {
+    void* item =NULL;
+    pthread_mutex_lock( &q->lock );
+    while( q->count == 0 && q->producers > 0 )
+        pthread_cond_wait( &q->notEmpty, &q->lock );
+    if( q->count ) {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_cond_signal( &q->notFull );
+    }
+    pthread_mutex_unlock( &q->lock );
+    return item;
+}
+
+/*
+ * Called once by every producer when it will not push any more items
+ */
+void
+pipeline_queue_close( pipeline_queue_t* q ) {
+    pthread_mutex_lock( &q->lock );
+    if( --q->producers == 0 )
+        pthread_cond_broadcast( &q->notEmpty );
+    pthread_mutex_unlock( &q->lock );
+}
+
+void
+pipeline_pool_init( pipeline_pool_t* p ) {
+    p->items =NULL;
+    p->count =0;
+    p->capacity =0;
+    pthread_mutex_init( &p->lock, NULL );
+}
+
+/*
+ * Free all spare objects with freeItem and release the pool
+ */
+void
+pipeline_pool_destroy( pipeline_pool_t* p, void (*freeItem)( void* ) ) {
+    for( int i =0; i < p->count; i++ )
+        freeItem( p->items[i] );
+    pthread_mutex_destroy( &p->lock );
+    free( p->items );
+}
+
+/*
+ * Returns a spare object, or NULL if there is none and the caller should allocate one
+ */
+void*
+pipeline_pool_take( pipeline_pool_t* p ) {
+    void* item =NULL;
+    pthread_mutex_lock( &p->lock );
+    if( p->count )
+        item = p->items[--p->count];
+    pthread_mutex_unlock( &p->lock );
+    return item;
+}
+
+/*
+ * Add an object that is no longer used to the pool
+ */
+void
+pipeline_pool_give( pipeline_pool_t* p, void* item ) {
+    pthread_mutex_lock( &p->lock );
+    if( p->count == p->capacity ) {
+        p->capacity = p->capacity ? p->capacity * 2 : 64;
+        p->items = (void**)realloc( p->items, sizeof( void* ) * p->capacity );
+    }
+    p->items[p->count++] = item;
+    pthread_mutex_unlock( &p->lock );
+}
+
+typedef struct {
+    pipeline_func_t func;
+    void* arg;
+    int worker;
+} pipeline_worker_t;
+
+static void*
+pipeline_worker( void* arg ) {
+    pipeline_worker_t* pw = (pipeline_worker_t*)arg;
+    pw->func( pw->arg, pw->worker );
+    return NULL;
+}
+
+/*
+ * Start the given number of threads for every stage and return when all of them have finished.
+ * The stages communicate through queues of their own, which are passed in arg.
+ */
+void
+pipeline_run( const pipeline_stage_t* stages, int count, void* arg ) {
+    int total =0;
+    for( int s =0; s < count; s++ )
+        total += stages[s].threads;
+
+    pthread_t th[total];
+    pipeline_worker_t pw[total];
+    int t =0;
+    for( int s =0; s < count; s++ ) {
+        for( int i =0; i < stages[s].threads; i++, t++ ) {
+            pw[t].func = stages[s].func;
+            pw[t].arg =arg;
+            pw[t].worker =i;
+            pthread_create( &th[t], NULL, pipeline_worker, &pw[t] );
+        }
+    }
+    for( t =0; t < total; t++ )
+        pthread_join( th[t], NULL );
+}
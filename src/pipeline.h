@@ -0,0 +1,76 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+// Stages of worker threads connected by bounded queues
+
+#include <stdbool.h>
+#include <pthread.h>
+
+/* A bounded FIFO queue of pointers with a known number of producer threads.
+ * Once every producer has called pipeline_queue_close() and the queue is empty,
+ * pipeline_queue_pop() returns NULL.
+ */
+typedef struct {
+    void** items;
+    int capacity;
+    int head, count;
+    int producers;      // producers that have not closed the queue yet
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty, notFull;
+} pipeline_queue_t;
+
+/* Spare objects of one kind, which stages hand out again instead of allocating new ones */
+typedef struct {
+    void** items;
+    int count, capacity;
+    pthread_mutex_t lock;
+} pipeline_pool_t;
+
+/* Called on each of the threads of a stage, worker is the index of the thread within the stage.
+ * The function returns when its input is exhausted, after closing its output queues.
+ */
+typedef void (*pipeline_func_t)( void* arg, int worker );
+
+typedef struct {
+    pipeline_func_t func;
+    int threads;
+} pipeline_stage_t;
+
+void
+pipeline_queue_init( pipeline_queue_t* q, int capacity, int producers );
+
+void
+pipeline_queue_destroy( pipeline_queue_t* q );
+
+void
+pipeline_queue_push( pipeline_queue_t* q, void* item );
+
+void*
+pipeline_queue_pop( pipeline_queue_t* q );
+
+void
+pipeline_queue_close( pipeline_queue_t* q );
+
+void
+pipeline_pool_init( pipeline_pool_t* p );
+
+void
+pipeline_pool_destroy( pipeline_pool_t* p, void (*freeItem)( void* ) );
+
+void*
+pipeline_pool_take( pipeline_pool_t* p );
+
+void
+pipeline_pool_give( pipeline_pool_t* p, void* item );
+
+void
+pipeline_run( const pipeline_stage_t* stages, int count, void* arg );
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "query.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int
+query_cmpOffset( const void* a, const void* b ) {
+    const pattern_offset_t* oa = (const pattern_offset_t*)a;
+    const pattern_offset_t* ob = (const pattern_offset_t*)b;
+    if( oa->row != ob->row )
+        return oa->row < ob->row ? -1 : 1;
+    return oa->col < ob->col ? -1 : oa->col > ob->col;
+}
+
+static int
+query_cmpRegion( const void* a, const void* b ) {
+    const region_t* ra = *(const region_t* const*)a;
+    const region_t* rb = *(const region_t* const*)b;
+    if( ra->pivot.row != rb->pivot.row )
+        return ra->pivot.row < rb->pivot.row ? -1 : 1;
+    return ra->pivot.col < rb->pivot.col ? -1 : ra->pivot.col > rb->pivot.col;
+}
+
+/*
+ * Build the index of the regions of v. The code table and the encoding of v must not change as long as it is in use.
+ */
+query_index_t*
+query_index_create( vouw_t* v ) {
+    query_index_t* q = (query_index_t*)malloc( sizeof( query_index_t ) );
+    const rfca_buffer_t* b = v->rfca->buffer;
+    q->v =v;
+
+    q->patternCount = pattern_list_setIndices( v->codeTable );
+    q->patterns = (query_pattern_t*)malloc( sizeof( query_pattern_t ) * q->patternCount );
+    bool first =true;
+    struct list_head* pos;
+    list_for_each( pos, &(v->codeTable->list) ) {
+        pattern_t* p = list_entry( pos, pattern_t, list );
+        query_pattern_t* qp = &q->patterns[p->index];
+        qp->size = p->size;
+        qp->bounds = pattern_computeBounds( p );
+        qp->offsets = (pattern_offset_t*)malloc( sizeof( pattern_offset_t ) * p->size );
+        memcpy( qp->offsets, p->offsets, sizeof( pattern_offset_t ) * p->size );
+        qsort( qp->offsets, p->size, sizeof( pattern_offset_t ), query_cmpOffset );
+
+        if( first || qp->bounds.rowMin < q->bounds.rowMin ) q->bounds.rowMin = qp->bounds.rowMin;
+        if( first || qp->bounds.rowMax > q->bounds.rowMax ) q->bounds.rowMax = qp->bounds.rowMax;
+        if( first || qp->bounds.colMin < q->bounds.colMin ) q->bounds.colMin = qp->bounds.colMin;
+        if( first || qp->bounds.colMax > q->bounds.colMax ) q->bounds.colMax = qp->bounds.colMax;
+        first =false;
+    }
+
+    uint64_t count =0;
+    list_for_each( pos, &(v->encoded->list) )
+        count++;
+    q->regions = (const region_t**)malloc( sizeof( region_t* ) * (count + 1) );
+    q->rowStart = (uint64_t*)calloc( b->rowCount + 1, sizeof( uint64_t ) );
+    count =0;
+    list_for_each( pos, &(v->encoded->list) ) {
+        const region_t* region = list_entry( pos, region_t, list );
+        q->regions[count++] = region;
+        q->rowStart[region->pivot.row + 1]++;
+    }
+    qsort( q->regions, count, sizeof( region_t* ), query_cmpRegion );
+    for( int i =0; i < b->rowCount; i++ )
+        q->rowStart[i+1] += q->rowStart[i];
+    return q;
+}
+
+void
+query_index_free( query_index_t* q ) {
+    for( int i =0; i < q->patternCount; i++ )
+        free( q->patterns[i].offsets );
+    free( q->patterns );
+    free( q->regions );
+    free( q->rowStart );
+    free( q );
+}
+
+/*
+ * Returns the index of the first region on pivot row `row' with a pivot column of at least col
+ */
+static uint64_t
+query_findColumn( const query_index_t* q, int row, int col ) {
+    uint64_t lo = q->rowStart[row], hi = q->rowStart[row+1];
+    while( lo < hi ) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if( q->regions[mid]->pivot.col < col )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static const pattern_offset_t*
+query_findOffset( const query_pattern_t* qp, int row, int col ) {
+    if( row < qp->bounds.rowMin || row > qp->bounds.rowMax || col < qp->bounds.colMin || col > qp->bounds.colMax )
+        return NULL;
+    const pattern_offset_t key = { row, col, 0 };
+    return (const pattern_offset_t*)bsearch( &key, qp->offsets, qp->size, sizeof( pattern_offset_t ), query_cmpOffset );
+}
+
+/*
+ * Find the value of the node at the logical coordinate c from the region that covers it.
+ * Returns false if c lies outside of the automaton.
+ */
+bool
+query_value( const query_index_t* q, rfca_coord_t c, rfca_node_t* value ) {
+    const rfca_t* r = q->v->rfca;
+    if( !rfca_checkBounds( r, c ) )
+        return false;
+
+    // The pivot of the covering region lies up to the extent of the largest pattern before c
+    int firstRow = c.row - q->bounds.rowMax, lastRow = c.row - q->bounds.rowMin;
+    if( firstRow < 0 ) firstRow =0;
+    if( lastRow >= r->buffer->rowCount ) lastRow = r->buffer->rowCount - 1;
+    for( int row = firstRow; row <= lastRow; row++ ) {
+        const int lastCol = c.col - q->bounds.colMin;
+        for( uint64_t i = query_findColumn( q, row, c.col - q->bounds.colMax );
+             i < q->rowStart[row+1] && q->regions[i]->pivot.col <= lastCol; i++ ) {
+            const region_t* region = q->regions[i];
+            const pattern_offset_t* o = query_findOffset( &q->patterns[region->pattern->index],
+                c.row - region->pivot.row, c.col - region->pivot.col );
+            if( o ) {
+                *value = (o->value + region->variant) % r->opts.base;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*
+ * Find the values of all nodes of the window from first to last, inclusive, in logical coordinates.
+ * The values are written row by row to values, which holds a value for every coordinate of the window;
+ * coordinates outside of the automaton are set to RFCA_MASKED_VALUE.
+ * Returns the number of regions that overlap the window.
+ */
+uint64_t
+query_window( const query_index_t* q, rfca_coord_t first, rfca_coord_t last, rfca_node_t* values ) {
+    const rfca_t* r = q->v->rfca;
+    const int width = last.col - first.col + 1;
+    for( int i =0; i < (last.row - first.row + 1) * width; i++ )
+        values[i] = RFCA_MASKED_VALUE;
+
+    uint64_t regions =0;
+    int firstRow = first.row - q->bounds.rowMax, lastRow = last.row - q->bounds.rowMin;
+    if( firstRow < 0 ) firstRow =0;
+    if( lastRow >= r->buffer->rowCount ) lastRow = r->buffer->rowCount - 1;
+    for( int row = firstRow; row <= lastRow; row++ ) {
+        const int lastCol = last.col - q->bounds.colMin;
+        for( uint64_t i = query_findColumn( q, row, first.col - q->bounds.colMax );
+             i < q->rowStart[row+1] && q->regions[i]->pivot.col <= lastCol; i++ ) {
+            const region_t* region = q->regions[i];
+            const query_pattern_t* qp = &q->patterns[region->pattern->index];
+            const rfca_coord_t p = region->pivot;
+            if( p.row + qp->bounds.rowMax < first.row || p.row + qp->bounds.rowMin > last.row ||
+                p.col + qp->bounds.colMax < first.col || p.col + qp->bounds.colMin > last.col )
+                continue;
+
+            bool overlaps =false;
+            for( int j =0; j < qp->size; j++ ) {
+                const pattern_offset_t o = qp->offsets[j];
+                const int nr = p.row + o.row, nc = p.col + o.col;
+                if( nr < first.row || nr > last.row || nc < first.col || nc > last.col )
+                    continue;
+                values[(nr - first.row) * width + (nc - first.col)] = (o.value + region->variant) % r->opts.base;
+                overlaps =true;
+            }
+            if( overlaps )
+                regions++;
+        }
+    }
+    return regions;
+}
@@ -0,0 +1,46 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+// Values of single nodes and windows of an encoded automaton, without decoding all of it
+
+#include "vouw.h"
+
+/* Offsets of a code table pattern sorted by row, then column, to find the offset that covers a node */
+typedef struct {
+    pattern_offset_t* offsets;
+    int size;
+    pattern_bounds_t bounds;
+} query_pattern_t;
+
+/* The regions of an encoding sorted by their pivots, row by row.
+ * A node can only be covered by a region whose pivot lies within the bounds of all patterns from it.
+ */
+typedef struct {
+    const vouw_t* v;
+    const region_t** regions;
+    uint64_t* rowStart;         // index of the first region of each pivot row, rowCount+1 entries
+    query_pattern_t* patterns;  // by pattern index
+    int patternCount;
+    pattern_bounds_t bounds;    // union of the bounds of all patterns
+} query_index_t;
+
+query_index_t*
+query_index_create( vouw_t* v );
+
+void
+query_index_free( query_index_t* q );
+
+bool
+query_value( const query_index_t* q, rfca_coord_t c, rfca_node_t* value );
+
+uint64_t
+query_window( const query_index_t* q, rfca_coord_t first, rfca_coord_t last, rfca_node_t* values );
+
+#endif
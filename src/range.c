@@ -0,0 +1,136 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "range.h"
+
+// The range is renormalized a byte at a time whenever it drops below this value
+#define RANGE_BOTTOM (1u << 24)
+
+void
+range_encoder_init( range_encoder_t* e, FILE* file ) {
+    e->file =file;
+    e->low =0;
+    e->range =0xFFFFFFFFu;
+    e->cache =0;
+    e->cacheSize =1;
+    e->bytes =0;
+}
+
+/*
+ * Move the top byte of low to the output. A byte is held back as long as a carry may still change it,
+ * along with the 0xFF bytes that follow it.
+ */
+static void
+range_shiftLow( range_encoder_t* e ) {
+    if( (uint32_t)e->low < 0xFF000000u || (e->low >> 32) != 0 ) {
+        const uint8_t carry = (uint8_t)(e->low >> 32);
+        uint8_t byte = e->cache;
+        do {
+            putc( (uint8_t)(byte + carry), e->file );
+            e->bytes++;
+            byte =0xFF;
+        } while( --e->cacheSize != 0 );
+        e->cache = (uint8_t)(e->low >> 24);
+    }
+    e->cacheSize++;
+    e->low = (e->low & 0x00FFFFFFu) << 8;
+}
+
+/*
+ * Encode the symbol that takes up [cum, cum+freq) of total, which is at most RANGE_TOTAL_MAX
+ */
+void
+range_encode( range_encoder_t* e, uint32_t cum, uint32_t freq, uint32_t total ) {
+    const uint32_t step = e->range / total;
+    e->low += (uint64_t)step * cum;
+    e->range = step * freq;
+    while( e->range < RANGE_BOTTOM ) {
+        e->range <<= 8;
+        range_shiftLow( e );
+    }
+}
+
+/*
+ * Encode a value below n, all of which are equally likely, 16 bits at a time
+ */
+void
+range_encodeUniform( range_encoder_t* e, uint64_t value, uint64_t n ) {
+    while( n > RANGE_TOTAL_MAX ) {
+        range_encode( e, (uint32_t)(value & (RANGE_TOTAL_MAX-1)), 1, RANGE_TOTAL_MAX );
+        value >>= 16;
+        n = ((n-1) >> 16) + 1;
+    }
+    if( n > 1 )
+        range_encode( e, (uint32_t)value, 1, (uint32_t)n );
+}
+
+/*
+ * Write the remaining bytes, after which the stream can be decoded completely
+ */
+void
+range_encoder_finish( range_encoder_t* e ) {
+    for( int i =0; i < 5; i++ )
+        range_shiftLow( e );
+}
+
+static uint8_t
+range_nextByte( range_decoder_t* d ) {
+    const int c = getc( d->file );
+    d->bytes++;
+    return c == EOF ? 0 : (uint8_t)c;
+}
+
+void
+range_decoder_init( range_decoder_t* d, FILE* file ) {
+    d->file =file;
+    d->code =0;
+    d->range =0xFFFFFFFFu;
+    d->step =1;
+    d->bytes =0;
+    // The first byte is the initial cache of the encoder, which is always zero
+    for( int i =0; i < 5; i++ )
+        d->code = (d->code << 8) | range_nextByte( d );
+}
+
+/*
+ * Returns the position within total of the next symbol, which must then be removed with range_decode()
+ */
+uint32_t
+range_decodeFreq( range_decoder_t* d, uint32_t total ) {
+    d->step = d->range / total;
+    const uint32_t value = d->code / d->step;
+    return value < total ? value : total - 1;
+}
+
+void
+range_decode( range_decoder_t* d, uint32_t cum, uint32_t freq ) {
+    d->code -= d->step * cum;
+    d->range = d->step * freq;
+    while( d->range < RANGE_BOTTOM ) {
+        d->code = (d->code << 8) | range_nextByte( d );
+        d->range <<= 8;
+    }
+}
+
+uint64_t
+range_decodeUniform( range_decoder_t* d, uint64_t n ) {
+    uint64_t value =0;
+    int shift =0;
+    while( n > RANGE_TOTAL_MAX ) {
+        const uint32_t part = range_decodeFreq( d, RANGE_TOTAL_MAX );
+        range_decode( d, part, 1 );
+        value |= (uint64_t)part << shift;
+        shift += 16;
+        n = ((n-1) >> 16) + 1;
+    }
+    if( n > 1 ) {
+        const uint32_t part = range_decodeFreq( d, (uint32_t)n );
+        range_decode( d, part, 1 );
+        value |= (uint64_t)part << shift;
+    }
+    return value;
+}
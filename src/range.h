@@ -0,0 +1,60 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef RANGE_H
+#define RANGE_H
+
+// Range coder with static frequencies that reads and writes a stream
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Frequencies of the symbols of one decision must add up to at most this total
+#define RANGE_TOTAL_MAX (1u << 16)
+
+typedef struct {
+    FILE* file;
+    uint64_t low;
+    uint32_t range;
+    uint8_t cache;          // the last byte that may still change by a carry
+    uint64_t cacheSize;     // number of bytes held back, the cache and the 0xFF bytes after it
+    uint64_t bytes;         // number of bytes written
+} range_encoder_t;
+
+typedef struct {
+    FILE* file;
+    uint32_t code;
+    uint32_t range;
+    uint32_t step;          // range per unit of frequency of the current decision
+    uint64_t bytes;         // number of bytes read
+} range_decoder_t;
+
+void
+range_encoder_init( range_encoder_t* e, FILE* file );
+
+void
+range_encode( range_encoder_t* e, uint32_t cum, uint32_t freq, uint32_t total );
+
+void
+range_encodeUniform( range_encoder_t* e, uint64_t value, uint64_t n );
+
+void
+range_encoder_finish( range_encoder_t* e );
+
+void
+range_decoder_init( range_decoder_t* d, FILE* file );
+
+uint32_t
+range_decodeFreq( range_decoder_t* d, uint32_t total );
+
+void
+range_decode( range_decoder_t* d, uint32_t cum, uint32_t freq );
+
+uint64_t
+range_decodeUniform( range_decoder_t* d, uint64_t n );
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "results.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define RESULTS_MAGIC "VOUWRES"
+#define RESULTS_VERSION 1
+
+void
+results_header_init( results_header_t* h, uint64_t rulespace, int64_t using, const char* description ) {
+    memset( h, 0, sizeof( results_header_t ) );
+    memcpy( h->magic, RESULTS_MAGIC, sizeof( RESULTS_MAGIC ) );
+    h->version =RESULTS_VERSION;
+    h->recordSize =sizeof( results_record_t );
+    h->rulespace =rulespace;
+    h->using =using;
+    strncpy( h->description, description, RESULTS_DESCRIPTION_MAX -1 );
+}
+
+/*
+ * Initialize a record of which only the printed value is known
+ */
+void
+results_record_init( results_record_t* r, uint64_t rule, double value ) {
+    r->rule =rule;
+    r->value =value;
+    r->uncompressed =NAN;
+    r->compressed =NAN;
+    r->steps =-1;
+    r->patterns =-1;
+    r->seconds =0.0;
+}
+
+/*
+ * Start a stream of results on file by writing the header
+ */
+results_writer_t*
+results_writer_open( FILE* file, const results_header_t* h ) {
+    results_writer_t* w = (results_writer_t*)malloc( sizeof( results_writer_t ) );
+    w->file =file;
+    w->count =0;
+    fwrite( h, sizeof( results_header_t ), 1, file );
+    return w;
+}
+
+static void
+results_writer_flush( results_writer_t* w ) {
+    fwrite( w->buffer, sizeof( results_record_t ), w->count, w->file );
+    w->count =0;
+}
+
+void
+results_writer_append( results_writer_t* w, const results_record_t* r ) {
+    if( w->count == RESULTS_BUFFER )
+        results_writer_flush( w );
+    w->buffer[w->count++] = *r;
+}
+
+/*
+ * Write the buffered records and release the writer, the file itself is not closed
+ */
+void
+results_writer_close( results_writer_t* w ) {
+    results_writer_flush( w );
+    fflush( w->file );
+    free( w );
+}
+
+/*
+ * Read and check the header of a stream of results, after which the records can be read with fread()
+ */
+bool
+results_readHeader( FILE* file, results_header_t* h ) {
+    return fread( h, sizeof( results_header_t ), 1, file ) == 1 &&
+        memcmp( h->magic, RESULTS_MAGIC, sizeof( RESULTS_MAGIC ) ) == 0 &&
+        h->version == RESULTS_VERSION && h->recordSize == sizeof( results_record_t );
+}
@@ -0,0 +1,70 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+// Binary stream of fixed-width per-rule results of encode-all
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RESULTS_DESCRIPTION_MAX 2048
+// Number of records that are written at once
+#define RESULTS_BUFFER 4096
+
+/* The stream starts with this header and is followed by one record per rule, in rule order,
+ * up to the end of the stream. All fields are in the byte order of the machine that wrote them.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;        // sizeof( results_record_t )
+    uint64_t rulespace;
+    int64_t using;              // the rule of `using', or -1
+    char description[RESULTS_DESCRIPTION_MAX]; // of the run, as in the header of its checkpoint files
+} results_header_t;
+
+/* Lengths are only known for rules that were self-encoded in this run or found in the cache,
+ * the code table size only for rules that were self-encoded in this run.
+ */
+typedef struct {
+    uint64_t rule;
+    double value;               // the result as printed by encode-all
+    double uncompressed;        // bits before the first step, NaN if unknown
+    double compressed;          // bits after the last step, NaN if unknown
+    int32_t steps;              // -1 if unknown
+    int32_t patterns;           // number of patterns in the code table, -1 if unknown
+    double seconds;             // time spent encoding the rule in this run
+} results_record_t;
+
+typedef struct {
+    FILE* file;
+    results_record_t buffer[RESULTS_BUFFER];
+    int count;
+} results_writer_t;
+
+void
+results_header_init( results_header_t* h, uint64_t rulespace, int64_t using, const char* description );
+
+void
+results_record_init( results_record_t* r, uint64_t rule, double value );
+
+results_writer_t*
+results_writer_open( FILE* file, const results_header_t* h );
+
+void
+results_writer_append( results_writer_t* w, const results_record_t* r );
+
+void
+results_writer_close( results_writer_t* w );
+
+bool
+results_readHeader( FILE* file, results_header_t* h );
+
+#endif
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <assert.h>
 #include "ttable.h"
+#include "dataset.h"
 
 #define STEP_REDUCE 1
 #define STEP_FOLD 2
@@ -45,15 +46,48 @@ rfca_create( rfca_opts_t opts ) {
 
     r->opts = opts;
     r->buffer = rfca_buffer_create( opts.inputSize + opts.folds, opts.mode );
+    r->ttable = malloc( sizeof( rfca_node_t ) * pow64( opts.base, opts.mode ) );
+    rfca_reset( r, opts.rule );
+
+    return r;
+}
+
+/*
+ * Create an automaton of which only the shape is known, such as that of an encoding that is queried
+ * without decoding it. It has no storage for its nodes, so it cannot be generated or read:
+ * only its bounds can be used (rfca_checkBounds(), rfca_rowLength()).
+ */
+rfca_t*
+rfca_createShape( rfca_opts_t opts ) {
+    rfca_t* r = malloc( sizeof( rfca_t ) );
+
+    r->opts = opts;
+    r->buffer = rfca_buffer_createShape( opts.inputSize + opts.folds, opts.mode );
+    r->ttable = NULL;
+    r->folds = opts.folds;
+    r->cur.row = r->cur.col = 0;
+
+    return r;
+}
+
+/*
+ * Prepare r to generate the automaton of another rule of the same class, reusing its storage.
+ * As after rfca_create(), the nodes are not yet computed (see rfca_generate())
+ */
+void
+rfca_reset( rfca_t* r, uint64_t rule ) {
+    const rfca_opts_t opts = r->opts;
+    r->opts.rule = rule;
 
     // Write the input at the beginning
     // If right == true, we simply reverse the input in order to keep all other code simpler
+    // All other nodes are overwritten by rfca_generate()
     for( int i =0; i < opts.inputSize; i++ ) {
         r->buffer->rows[0].cols[i] = 
             opts.right ? opts.input[i] : opts.input[(opts.inputSize - 1)- i];
 
         // Sanity check, user input should also be checked elsewhere!
-        if( r->buffer->rows[0].cols[i] >= opts.base ) 
+        if( r->buffer->rows[0].cols[i] >= (rfca_node_t)opts.base ) 
             r->buffer->rows[0].cols[i] = opts.base-1;
     }
 
@@ -62,9 +96,7 @@ rfca_create( rfca_opts_t opts ) {
     r->cur.col = opts.inputSize-1; // Position at the last input node
 
     // Finally, populate the transition table based on base, mode and rule number
-    r->ttable = tt_make( opts.base, opts.mode, opts.rule );
-
-    return r;
+    tt_fill( r->ttable, opts.base, opts.mode, rule );
 }
 
 /* 
@@ -179,6 +211,12 @@ step( rfca_t* r ) {
  */
 void
 rfca_generate( rfca_t* r ) {
+    if( r->opts.file ) {
+        // The file was checked when the options were parsed, it can only fail if it has changed since
+        if( !dataset_load( r ) )
+            exit( EXIT_FAILURE );
+        return;
+    }
     while( step( r ) != STEP_DONE );
 }
 
@@ -25,6 +25,7 @@ typedef struct {
     int inputSize;
     int folds;
     bool right; // right-folding automaton
+    const char* file; // if set, the nodes are read from this file instead of being generated, see dataset.h
 } rfca_opts_t;
 
 typedef struct {
@@ -38,6 +39,12 @@ typedef struct {
 rfca_t*
 rfca_create( rfca_opts_t opts );
 
+rfca_t*
+rfca_createShape( rfca_opts_t opts );
+
+void
+rfca_reset( rfca_t* r, uint64_t rule );
+
 void
 rfca_free( rfca_t* r );
 
@@ -47,6 +54,10 @@ rfca_maxRules( int base, int mode );
 void
 rfca_generate( rfca_t* r );
 
+/* Compute the next node or fold, returns 0 once every node has been computed */
+int 
+step( rfca_t* r );
+
 rfca_node_t 
 rfca_value( const rfca_t* r, rfca_coord_t c );
 
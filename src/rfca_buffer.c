@@ -10,8 +10,12 @@
 #include <string.h>
 #include <assert.h>
 
+/*
+ * Create a buffer with the rows of an automaton of the given width and mode, but without storage for its nodes:
+ * the cols of every row are NULL. Only the shape of such a buffer can be used.
+ */
 rfca_buffer_t*
-rfca_buffer_create( int width, int mode ) {
+rfca_buffer_createShape( int width, int mode ) {
     rfca_buffer_t* b = (rfca_buffer_t*)malloc( sizeof( rfca_buffer_t ) );
     
     // We will preallocate everything, growing/shrinking is NOT supported for performance reasons
@@ -27,19 +31,30 @@ rfca_buffer_create( int width, int mode ) {
         b->nodeCount += i;
     }
 
-    // Allocate and zero all rows
     b->rows = malloc( sizeof( rfca_row_t ) * b->rowCount );
     int rowLength = width;
     for( i =0; i < b->rowCount; i++ ) {
         b->rows[i].size = rowLength;
-        b->rows[i].cols = malloc( sizeof( rfca_node_t ) * rowLength );
-        memset( b->rows[i].cols, 0, rowLength );
+        b->rows[i].cols = NULL;
         rowLength -= mode-1;
     }
 
     return b;
 }
 
+rfca_buffer_t*
+rfca_buffer_create( int width, int mode ) {
+    rfca_buffer_t* b = rfca_buffer_createShape( width, mode );
+
+    // Allocate and zero all rows
+    for( int i =0; i < b->rowCount; i++ ) {
+        b->rows[i].cols = malloc( sizeof( rfca_node_t ) * b->rows[i].size );
+        memset( b->rows[i].cols, 0, sizeof( rfca_node_t ) * b->rows[i].size );
+    }
+
+    return b;
+}
+
 void
 rfca_buffer_free( rfca_buffer_t* b ) {
     for( int i =0; i < b->rowCount; i++ ) {
@@ -55,7 +70,7 @@ rfca_buffer_free( rfca_buffer_t* b ) {
 void
 rfca_buffer_clear( rfca_buffer_t* b ) {
     for( int i =0; i < b->rowCount; i++ ) {
-        memset( b->rows[i].cols, 0, b->rows[i].size );
+        memset( b->rows[i].cols, 0, sizeof( rfca_node_t ) * b->rows[i].size );
     }
 }
 
@@ -111,3 +126,17 @@ rfca_buffer_isEqual( const rfca_buffer_t* b1, const rfca_buffer_t* b2 ) {
     }
     return true;
 }
+
+/*
+ * Returns a 64-bit FNV-1a hash of the size and values of b
+ */
+uint64_t
+rfca_buffer_hash( const rfca_buffer_t* b ) {
+    uint64_t h = 14695981039346656037ULL;
+    for( int i =0; i < b->rowCount; i++ ) {
+        h = (h ^ (uint64_t)b->rows[i].size) * 1099511628211ULL;
+        for( int j =0; j < b->rows[i].size; j++ )
+            h = (h ^ b->rows[i].cols[j]) * 1099511628211ULL;
+    }
+    return h;
+}
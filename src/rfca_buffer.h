@@ -34,6 +34,9 @@ typedef struct {
 rfca_buffer_t*
 rfca_buffer_create( int width, int mode );
 
+rfca_buffer_t*
+rfca_buffer_createShape( int width, int mode );
+
 void
 rfca_buffer_free( rfca_buffer_t* b );
 
@@ -55,4 +58,7 @@ rfca_buffer_checkBounds( const rfca_buffer_t* b, rfca_coord_t c );
 bool
 rfca_buffer_isEqual( const rfca_buffer_t* b1, const rfca_buffer_t* b2 );
 
+uint64_t
+rfca_buffer_hash( const rfca_buffer_t* b );
+
 #endif
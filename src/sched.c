@@ -0,0 +1,183 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "sched.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/* The items that are still to be processed by one worker.
+ * The owner takes items from the front, thieves split off the back half.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t lo, hi;
+} sched_queue_t;
+
+typedef struct {
+    sched_queue_t* queues;
+    int threads;
+    sched_func_t func;
+    void* arg;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t done;
+} sched_t;
+
+typedef struct {
+    sched_t* s;
+    int worker;
+} sched_worker_t;
+
+static bool
+sched_take( sched_queue_t* q, uint64_t* item ) {
+    bool ok =false;
+    pthread_mutex_lock( &q->lock );
+    if( q->lo < q->hi ) {
+        *item = q->lo++;
+        ok =true;
+    }
+    pthread_mutex_unlock( &q->lock );
+    return ok;
+}
+
+/*
+ * Move the back half of the fullest other queue to the queue of worker w
+ * and take its first item. Returns false if there is no work left anywhere.
+ */
+static bool
+sched_steal( sched_t* s, int w, uint64_t* item ) {
+    for( ;; ) {
+        int victim =-1;
+        uint64_t most =0;
+        for( int i =1; i < s->threads; i++ ) {
+            sched_queue_t* q = &s->queues[(w + i) % s->threads];
+            pthread_mutex_lock( &q->lock );
+            uint64_t remaining = q->hi - q->lo;
+            pthread_mutex_unlock( &q->lock );
+            if( remaining > most ) {
+                most =remaining;
+                victim = (w + i) % s->threads;
+            }
+        }
+        if( victim < 0 )
+            return false;
+
+        // The victim may have made progress since, so check again while holding its lock
+        sched_queue_t* q = &s->queues[victim];
+        uint64_t lo, hi;
+        pthread_mutex_lock( &q->lock );
+        hi = q->hi;
+        lo = q->lo + (q->hi - q->lo) / 2;
+        if( lo < hi )
+            q->hi = lo;
+        pthread_mutex_unlock( &q->lock );
+        if( lo >= hi )
+            continue;
+
+        *item = lo;
+        sched_queue_t* own = &s->queues[w];
+        pthread_mutex_lock( &own->lock );
+        own->lo = lo + 1;
+        own->hi = hi;
+        pthread_mutex_unlock( &own->lock );
+        return true;
+    }
+}
+
+static void*
+sched_worker( void* arg ) {
+    sched_worker_t* sw = (sched_worker_t*)arg;
+    sched_t* s = sw->s;
+    uint64_t item;
+
+    while( sched_take( &s->queues[sw->worker], &item ) || sched_steal( s, sw->worker, &item ) ) {
+        s->func( s->arg, item, sw->worker );
+
+        pthread_mutex_lock( &s->lock );
+        s->done++;
+        pthread_cond_signal( &s->cond );
+        pthread_mutex_unlock( &s->lock );
+    }
+    return NULL;
+}
+
+/*
+ * Call func for items first .. first+count-1 on the given number of worker threads.
+ * Every worker starts with an equal share of consecutive items and steals from the others
+ * once it runs out, so items of very different cost are balanced automatically.
+ * If notify is not NULL, it is called from the calling thread as items complete,
+ * the last call has done == count. Returns when all items are done.
+ */
+void
+sched_run( uint64_t first, uint64_t count, int threads, sched_func_t func, sched_notify_t notify, void* arg ) {
+    if( threads < 1 )
+        threads =1;
+
+    sched_t s;
+    s.threads =threads;
+    s.func =func;
+    s.arg =arg;
+    s.done =0;
+    pthread_mutex_init( &s.lock, NULL );
+    pthread_cond_init( &s.cond, NULL );
+    s.queues = (sched_queue_t*)malloc( sizeof( sched_queue_t ) * threads );
+    for( int i =0; i < threads; i++ ) {
+        pthread_mutex_init( &s.queues[i].lock, NULL );
+        s.queues[i].lo = first + count * i / threads;
+        s.queues[i].hi = first + count * (i+1) / threads;
+    }
+
+    pthread_t th[threads];
+    sched_worker_t sw[threads];
+    for( int i =0; i < threads; i++ ) {
+        sw[i].s = &s;
+        sw[i].worker =i;
+        pthread_create( &th[i], NULL, sched_worker, &sw[i] );
+    }
+
+    uint64_t reported =0;
+    pthread_mutex_lock( &s.lock );
+    while( reported < count ) {
+        while( s.done == reported )
+            pthread_cond_wait( &s.cond, &s.lock );
+        reported = s.done;
+        if( notify ) {
+            pthread_mutex_unlock( &s.lock );
+            notify( arg, reported );
+            pthread_mutex_lock( &s.lock );
+        }
+    }
+    pthread_mutex_unlock( &s.lock );
+
+    for( int i =0; i < threads; i++ )
+        pthread_join( th[i], NULL );
+    for( int i =0; i < threads; i++ )
+        pthread_mutex_destroy( &s.queues[i].lock );
+    pthread_mutex_destroy( &s.lock );
+    pthread_cond_destroy( &s.cond );
+    free( s.queues );
+}
+
+/*
+ * Consume a leading `-j N' or `--threads N' from the argument list.
+ * Returns 1 if it was found, 0 if not and -1 if N is missing or invalid.
+ */
+int
+sched_parseThreads( int* threads, char*** argv_ptr, int* argc ) {
+    char** argv = *argv_ptr;
+    if( *argc < 1 || (strcmp( argv[0], "-j" ) != 0 && strcmp( argv[0], "--threads" ) != 0) )
+        return 0;
+    if( *argc < 2 || atoi( argv[1] ) < 1 )
+        return -1;
+    *threads = atoi( argv[1] );
+    *argv_ptr += 2;
+    *argc -= 2;
+    return 1;
+}
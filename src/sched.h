@@ -0,0 +1,28 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+// Work-stealing execution of independent work items, such as the rules in a rulespace
+
+#include <stdint.h>
+
+/* Called once for each item, worker is the index of the calling thread in [0,threads) */
+typedef void (*sched_func_t)( void* arg, uint64_t item, int worker );
+
+/* Called on the thread that invoked sched_run() whenever items have finished,
+ * done is the total number of finished items so far */
+typedef void (*sched_notify_t)( void* arg, uint64_t done );
+
+void
+sched_run( uint64_t first, uint64_t count, int threads, sched_func_t func, sched_notify_t notify, void* arg );
+
+int
+sched_parseThreads( int* threads, char*** argv_ptr, int* argc );
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#define _POSIX_C_SOURCE 200809L // flockfile()
+
+#include "sketch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static uint64_t
+sketch_mix( uint64_t x ) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/*
+ * Compute the MinHash sketch of a code table. Patterns are identified by the hash of their
+ * canonical form and weighted by their usage: a pattern that is used u times counts as
+ * 1 + floor(log2(u)) elements, so that the sketch is not dominated by the singleton pattern.
+ * Unused patterns are left out.
+ */
+void
+sketch_compute( sketch_t* s, uint64_t rule, double uncompressed, double compressed, const pattern_t* codeTable ) {
+    s->rule = rule;
+    s->uncompressed = uncompressed;
+    s->compressed = compressed;
+    for( int i =0; i < SKETCH_SIZE; i++ )
+        s->mins[i] = UINT32_MAX;
+
+    struct list_head* pos;
+    list_for_each( pos, &(codeTable->list) ) {
+        const pattern_t* p = list_entry( pos, pattern_t, list );
+        int weight =0;
+        for( unsigned int u = p->usage; u; u >>= 1 )
+            weight++;
+        for( int w =0; w < weight; w++ ) {
+            const uint64_t element = sketch_mix( p->hash + (uint64_t)w );
+            for( int i =0; i < SKETCH_SIZE; i++ ) {
+                const uint32_t h = (uint32_t)(sketch_mix( element ^ ((uint64_t)(i+1) * 0x9e3779b97f4a7c15ULL) ) >> 32);
+                if( h < s->mins[i] )
+                    s->mins[i] = h;
+            }
+        }
+    }
+}
+
+/*
+ * Estimate the weighted Jaccard similarity of the code tables of two sketches, between 0 and 1
+ */
+double
+sketch_similarity( const sketch_t* a, const sketch_t* b ) {
+    int same =0;
+    for( int i =0; i < SKETCH_SIZE; i++ )
+        same += a->mins[i] == b->mins[i];
+    return (double)same / (double)SKETCH_SIZE;
+}
+
+static int
+sketch_cmp( const void* a, const void* b ) {
+    const sketch_t* sa = (const sketch_t*)a;
+    const sketch_t* sb = (const sketch_t*)b;
+    return sa->rule < sb->rule ? -1 : sa->rule > sb->rule;
+}
+
+static bool
+sketch_parseLine( sketch_t* s, const char* line ) {
+    char* end;
+    if( sscanf( line, "%"SCNu64" %la %la", &s->rule, &s->uncompressed, &s->compressed ) != 3 )
+        return false;
+    // Skip the rule and the lengths
+    for( int i =0; i < 3 && line; i++ )
+        line = strchr( line + (i > 0), ' ' );
+    for( int i =0; i < SKETCH_SIZE; i++ ) {
+        if( !line )
+            return false;
+        s->mins[i] = (uint32_t)strtoul( line, &end, 16 );
+        if( end == line )
+            return false;
+        line = end;
+    }
+    return true;
+}
+
+/*
+ * Open a sketch file for appending and read the sketches in it. If the file already holds sketches,
+ * its header must equal the given header.
+ * Returns NULL and prints an error message if the file cannot be used.
+ */
+sketch_file_t*
+sketch_file_open( const char* path, const char* header ) {
+    sketch_file_t* sf = (sketch_file_t*)malloc( sizeof( sketch_file_t ) );
+    sf->file =NULL;
+    sf->header[0] ='\0';
+    sf->sketches =NULL;
+    sf->count =0;
+
+    bool newline =true;
+    FILE* f = fopen( path, "r" );
+    if( f ) {
+        char line[SKETCH_HEADER_MAX];
+        uint64_t capacity =0;
+        if( fgets( sf->header, sizeof( sf->header ), f ) ) {
+            newline = strchr( sf->header, '\n' ) != NULL;
+            sf->header[strcspn( sf->header, "\n" )] ='\0';
+            if( strcmp( sf->header, header ) != 0 ) {
+                fprintf( stderr, "Error: Sketch file `%s' was written for a different rule class:\n%s\n", path, sf->header );
+                fclose( f );
+                sketch_file_close( sf );
+                return NULL;
+            }
+        }
+        while( fgets( line, sizeof( line ), f ) ) {
+            // A line that was only partially written when a run was killed is ignored
+            newline = strchr( line, '\n' ) != NULL;
+            if( sf->count == capacity ) {
+                capacity = capacity ? capacity * 2 : 1024;
+                sf->sketches = (sketch_t*)realloc( sf->sketches, sizeof( sketch_t ) * capacity );
+            }
+            if( newline && sketch_parseLine( &sf->sketches[sf->count], line ) )
+                sf->count++;
+        }
+        fclose( f );
+        qsort( sf->sketches, sf->count, sizeof( sketch_t ), sketch_cmp );
+    }
+
+    sf->file = fopen( path, "a" );
+    if( !sf->file ) {
+        fprintf( stderr, "Error: Cannot open sketch file `%s'\n", path );
+        sketch_file_close( sf );
+        return NULL;
+    }
+    if( sf->header[0] == '\0' ) {
+        strncpy( sf->header, header, sizeof( sf->header ) -1 );
+        sf->header[sizeof( sf->header ) -1] ='\0';
+        fprintf( sf->file, "%s\n", header );
+    } else if( !newline )
+        fputc( '\n', sf->file );
+    fflush( sf->file );
+    return sf;
+}
+
+/*
+ * Look up the sketch of rule among the sketches that were read from the file
+ */
+const sketch_t*
+sketch_file_find( const sketch_file_t* sf, uint64_t rule ) {
+    uint64_t lo =0, hi = sf->count;
+    while( lo < hi ) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if( sf->sketches[mid].rule < rule )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if( lo == sf->count || sf->sketches[lo].rule != rule )
+        return NULL;
+    return &sf->sketches[lo];
+}
+
+/*
+ * Append a sketch and flush it to the file. May be called from multiple threads.
+ * The sketch is not added to the sketches that were read from the file.
+ */
+void
+sketch_file_append( sketch_file_t* sf, const sketch_t* s ) {
+    flockfile( sf->file );
+    fprintf( sf->file, "%"PRIu64" %a %a", s->rule, s->uncompressed, s->compressed );
+    for( int i =0; i < SKETCH_SIZE; i++ )
+        fprintf( sf->file, " %08"PRIx32, s->mins[i] );
+    fputc( '\n', sf->file );
+    fflush( sf->file );
+    funlockfile( sf->file );
+}
+
+void
+sketch_file_close( sketch_file_t* sf ) {
+    if( sf->file )
+        fclose( sf->file );
+    free( sf->sketches );
+    free( sf );
+}
@@ -0,0 +1,60 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+// Compact MinHash sketches of code tables, to estimate which rules have similar code tables
+
+#include "pattern.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of hash functions, the similarity of two sketches is a multiple of 1/SKETCH_SIZE
+#define SKETCH_SIZE 64
+#define SKETCH_HEADER_MAX 2048
+
+/* A sketch of the code table of a self-encoded rule, along with its encoded length */
+typedef struct {
+    uint64_t rule;
+    double uncompressed;        // ctBits + encodedBits before the first step
+    double compressed;          // ctBits + encodedBits after the last step
+    uint32_t mins[SKETCH_SIZE]; // the smallest hash of the code table under each hash function
+} sketch_t;
+
+/* The first line of a sketch file describes the rule class, every other line holds
+ * one sketch as `rule uncompressed compressed min0 ... min63', with the lengths in hexadecimal floating point (%a)
+ * and the minima in hexadecimal. Sketches are only ever appended, so the file can be built up
+ * over several runs.
+ */
+typedef struct {
+    FILE* file;
+    char header[SKETCH_HEADER_MAX];
+    sketch_t* sketches;         // read from the file, sorted by rule
+    uint64_t count;
+} sketch_file_t;
+
+void
+sketch_compute( sketch_t* s, uint64_t rule, double uncompressed, double compressed, const pattern_t* codeTable );
+
+double
+sketch_similarity( const sketch_t* a, const sketch_t* b );
+
+sketch_file_t*
+sketch_file_open( const char* path, const char* header );
+
+const sketch_t*
+sketch_file_find( const sketch_file_t* sf, uint64_t rule );
+
+void
+sketch_file_append( sketch_file_t* sf, const sketch_t* s );
+
+void
+sketch_file_close( sketch_file_t* sf );
+
+#endif
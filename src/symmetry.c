@@ -0,0 +1,116 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#include "symmetry.h"
+
+static int
+gcd( int a, int b ) {
+    while( b ) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Find all affine value maps that leave the input of opts unchanged.
+ * Reflections and non-affine permutations do not preserve encoding lengths exactly
+ * and are therefore not considered.
+ */
+void
+symmetry_group_init( symmetry_group_t* g, const rfca_opts_t* opts ) {
+    g->base = opts->base;
+    g->mode = opts->mode;
+    g->count =0;
+
+    for( int a =1; a < g->base; a++ ) {
+        if( gcd( a, g->base ) != 1 )
+            continue;
+        for( int c =0; c < g->base; c++ ) {
+            bool fixed =true;
+            for( int i =0; i < opts->inputSize && fixed; i++ )
+                fixed = (a * opts->input[i] + c) % g->base == opts->input[i];
+            if( !fixed || g->count == SYMMETRY_MAX )
+                continue;
+            // The identity is always the first
+            symmetry_t* s = &g->maps[g->count++];
+            s->a =a;
+            s->c =c;
+        }
+    }
+}
+
+/*
+ * Remove all maps from g that do not leave the automaton given by opts unchanged,
+ * that is, the ones that change its input or its rule.
+ * Only the identity remains if opts is of a different class.
+ */
+void
+symmetry_group_stabilize( symmetry_group_t* g, const rfca_opts_t* opts ) {
+    int n =0;
+    for( int i =0; i < g->count; i++ ) {
+        const symmetry_t* s = &g->maps[i];
+        bool fixed = i == 0 || (opts->base == g->base && opts->mode == g->mode);
+        for( int j =0; j < opts->inputSize && fixed && i > 0; j++ )
+            fixed = (s->a * opts->input[j] + s->c) % g->base == opts->input[j];
+        if( fixed && symmetry_apply( g, i, opts->rule ) == opts->rule )
+            g->maps[n++] = *s;
+    }
+    g->count =n;
+}
+
+/*
+ * Returns the number of the rule f.R.f^-1, where f is the given map of g and R is rule
+ */
+uint64_t
+symmetry_apply( const symmetry_group_t* g, int map, uint64_t rule ) {
+    const int base = g->base;
+    const int size = (int)pow64( base, g->mode );
+    const symmetry_t* f = &g->maps[map];
+    if( f->a == 1 && f->c == 0 )
+        return rule;
+
+    // Powers of the base, for the neighborhoods and for the digits of the rule number
+    uint64_t pw[size];
+    pw[0] =1;
+    for( int i =1; i < size; i++ )
+        pw[i] = pw[i-1] * base;
+
+    // The digit at tt_index( A ) of the rule number is the output for neighborhood A
+    uint64_t result =0;
+    for( int idx =0; idx < size; idx++ ) {
+        const int out = rule % base;
+        rule /= base;
+        int mapped =0;
+        for( int j =0; j < g->mode; j++ ) {
+            const int value = (idx / (int)pw[g->mode-1-j]) % base;
+            mapped += ((f->a * value + f->c) % base) * (int)pw[g->mode-1-j];
+        }
+        result += (uint64_t)((f->a * out + f->c) % base) * pw[mapped];
+    }
+    return result;
+}
+
+/*
+ * Returns the smallest rule not below min that is equivalent to rule under g,
+ * map is set to the index of a map that takes rule to it.
+ * Since the maps form a group, all rules of an equivalence class have the same representative.
+ */
+uint64_t
+symmetry_canonical( const symmetry_group_t* g, uint64_t rule, uint64_t min, int* map ) {
+    uint64_t best = rule;
+    *map =0;
+    for( int i =1; i < g->count; i++ ) {
+        uint64_t r = symmetry_apply( g, i, rule );
+        if( r >= min && r < best ) {
+            best = r;
+            *map = i;
+        }
+    }
+    return best;
+}
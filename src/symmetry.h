@@ -0,0 +1,50 @@
+/*
+ * VOUW - Generating, encoding and pattern-mining of Reduce-Fold Cellular Automata
+ *
+ * Micky Faas <micky@edukitty.org>
+ * Leiden Institute for Advanced Computer Science
+ */
+
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+// Rules that produce the same compression up to a relabeling of node values
+
+#include "rfca.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Maximum number of value maps for any base up to BASE_MAX
+#define SYMMETRY_MAX 32
+
+/* The value map x -> (a*x + c) mod base, with a invertible modulo base.
+ * A map that fixes every input node takes the automaton of rule R to that of the
+ * conjugated rule f.R.f^-1. Since pattern matching only compares values modulo base
+ * up to a constant variant, such a map leaves every encoding length exactly the same.
+ */
+typedef struct {
+    int a;
+    int c;
+} symmetry_t;
+
+/* A set of value maps that is closed under composition, the first one is the identity */
+typedef struct {
+    symmetry_t maps[SYMMETRY_MAX];
+    int count;
+    int base;
+    int mode;
+} symmetry_group_t;
+
+void
+symmetry_group_init( symmetry_group_t* g, const rfca_opts_t* opts );
+
+void
+symmetry_group_stabilize( symmetry_group_t* g, const rfca_opts_t* opts );
+
+uint64_t
+symmetry_apply( const symmetry_group_t* g, int map, uint64_t rule );
+
+uint64_t
+symmetry_canonical( const symmetry_group_t* g, uint64_t rule, uint64_t min, int* map );
+
+#endif
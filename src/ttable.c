@@ -29,7 +29,16 @@ rfca_node_t*
 tt_make( int base, int mode, uint64_t rule ) {
     int rulesize = pow64( base, mode );
     rfca_node_t* tt = malloc( sizeof( rfca_node_t ) * rulesize );
+    tt_fill( tt, base, mode, rule );
+    return tt;
+}
 
+/*
+ * Write the transition table for base, mode and rule# to tt, which holds (base^mode) entries
+ */
+void
+tt_fill( rfca_node_t* tt, int base, int mode, uint64_t rule ) {
+    int rulesize = pow64( base, mode );
     memset( tt, 0, rulesize * sizeof( rfca_node_t ) );
 
     uint64_t decimal = rule;
@@ -46,7 +55,6 @@ tt_make( int base, int mode, uint64_t rule ) {
         decimal = decimal / base;
         i++;
     }
-    return tt;
 }
 
 /* 
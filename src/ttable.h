@@ -19,6 +19,8 @@ varbase_incr( rfca_node_t A[], int base, int length );
 
 rfca_node_t*
 tt_make( int base, int mode, uint64_t rule );
+void
+tt_fill( rfca_node_t* tt, int base, int mode, uint64_t rule );
 int
 tt_index( int base, int mode, rfca_node_t* A );
 
@@ -6,6 +6,7 @@
  */
 
 #include "vouw.h"
+#include "sched.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
@@ -20,8 +21,8 @@ typedef struct {
 static void
 computeStdBits( vouw_t* v ) {
     //v->stdBitsPerOffset = log2( (double)v->rfca->opts.base );
-    v->stdBitsPerOffset = log2( (double)v->rfca->buffer->nodeCount ) + log2( v->rfca->opts.base );
-    v->stdBitsPerPivot = log2( (double)v->rfca->buffer->nodeCount );
+    v->stdBitsPerOffset = log2( (double)v->nodeCount ) + log2( v->rfca->opts.base );
+    v->stdBitsPerPivot = log2( (double)v->nodeCount );
     v->stdBitsPerVariant = log2( (double)v->rfca->opts.base );
 }
 
@@ -49,20 +50,11 @@ computeEncodedBits( vouw_t* v ) {
 
 static void
 updateEncodedLength( vouw_t* v ) {
-    pattern_list_updateCodeLength( v->codeTable, v->rfca->buffer->nodeCount );
+    pattern_list_updateCodeLength( v->codeTable, v->nodeCount );
     v->ctBits = computeCodeTableBits( v );
     v->encodedBits = computeEncodedBits( v );
 }
 
-static void
-maskRegion( rfca_t* r, pattern_t* p, rfca_coord_t pivot ) {
-    for( int i =0; i < p->size; i++ ) {
-        rfca_coord_t c = pattern_offset_abs( pivot, p->offsets[i] );
-
-        rfca_setMasked( r, c, true );
-    }
-}
-
 static int 
 computeUsage( vouw_t* v, pattern_t* p1, int v1, pattern_t* p2, int v2, pattern_offset_t p2_offset ) {
     int usage =0;
@@ -101,12 +93,14 @@ computeUsage( vouw_t* v, pattern_t* p1, int v1, pattern_t* p2, int v2, pattern_o
  * Calculate the gain in encoding size if patterns p1 and p2 were replaced by their union.
  * This union is assumed to have estimated usage p_usage,
  * which is assumed to be less or equal than the usages of p1 and p2.
+ * If the union is already in the code table as `existing', its usage is combined with p_usage
+ * and no new code table entry is needed.
  * The return value is the difference in encoding side in bits.
  */
 static double
-computeGain( vouw_t* v, pattern_t* p1, pattern_t* p2, int p_usage ) {
+computeGain( vouw_t* v, pattern_t* p1, pattern_t* p2, int p_usage, const pattern_t* existing ) {
 
-    const int totalNodes = v->rfca->buffer->nodeCount;
+    const int totalNodes = v->nodeCount;
     const double oldBits = v->ctBits + v->encodedBits; // MDL's L(M) + L(M|D)
     double newBits = oldBits;
 
@@ -131,6 +125,16 @@ computeGain( vouw_t* v, pattern_t* p1, pattern_t* p2, int p_usage ) {
         newBits -= (v->stdBitsPerOffset * p2->size + p2->codeLength);
 
     // Step 3. add the length from the union pattern p
+    if( existing ) {
+        // The regions of the existing pattern are re-encoded with the combined usage,
+        // its offsets are already in the code table
+        const int usage = existing->usage + p_usage;
+        double p_codeLength = -log2( (double)usage / (double)totalNodes );
+        newBits -= (existing->codeLength + v->stdBitsPerPivot + v->stdBitsPerVariant) * existing->usage;
+        newBits += (p_codeLength + v->stdBitsPerPivot + v->stdBitsPerVariant) * usage;
+        newBits += p_codeLength - existing->codeLength;
+        return oldBits - newBits;
+    }
     double p_codeLength = -log2( (double)p_usage / (double)totalNodes );  
     // data part
     newBits += (p_codeLength + v->stdBitsPerPivot + v->stdBitsPerVariant) * (p_usage);
@@ -140,21 +144,33 @@ computeGain( vouw_t* v, pattern_t* p1, pattern_t* p2, int p_usage ) {
     return oldBits - newBits;
 }
 
+/*
+ * Take a region from the spare regions of v, or allocate one if there are none
+ */
+static region_t*
+allocRegion( vouw_t* v ) {
+    if( list_empty( &v->spare ) )
+        return (region_t*)malloc( sizeof( region_t ) );
+    region_t* region = list_entry( v->spare.next, region_t, list );
+    list_del( &(region->list) );
+    return region;
+}
+
+/*
+ * Keep a region that is no longer part of the encoding for later use, it must not be in any list
+ */
+static void
+releaseRegion( vouw_t* v, region_t* region ) {
+    list_add( &(region->list), &v->spare );
+}
+
 static region_t*
-createRegion( vouw_t* v, pattern_t* p, rfca_coord_t pivot, int variant, bool mask ) {
-    region_t* region = (region_t*)malloc( sizeof( region_t ) );
+createRegion( vouw_t* v, pattern_t* p, rfca_coord_t pivot, int variant ) {
+    region_t* region = allocRegion( v );
     region->pivot =pivot;
     region->pattern =p;
     region->variant =variant;
-
-    if( mask ) {
-        for( int i =0; i < p->size; i++ ) {
-            // For each offset, compute its location on the automaton
-            rfca_coord_t c = pattern_offset_abs( pivot, p->offsets[i] );
-
-            rfca_setMasked( v->rfca, c, true );
-        }
-    }
+    region->masked =false;
 
     list_add( &(region->list), &(v->encoded->list) );
     return region;
@@ -165,8 +181,19 @@ mergeEncodedPatterns( vouw_t* v, pattern_t* p1, pattern_t* p2, int variant, patt
     const int base = v->rfca->opts.base;
     // Create the union pattern of p1 and p2
     pattern_t* p_union = pattern_createVariantUnion( p1, p2, variant, p2_offset, base );
-    //list_add( &(p_union->list), &(p2->list) );
-    list_add( &(p_union->list), &(v->codeTable->list) );
+    // Bring the union in canonical form, regions are corrected with the anchor below
+    pattern_offset_t anchor = pattern_canonicalize( p_union, base );
+
+    // The same shape may already be in the code table, in which case we combine usage
+    pattern_t* existing = pattern_index_find( v->ctIndex, p_union );
+    if( existing ) {
+        pattern_free( p_union );
+        p_union = existing;
+    } else {
+        //list_add( &(p_union->list), &(p2->list) );
+        list_add( &(p_union->list), &(v->codeTable->list) );
+        pattern_index_insert( v->ctIndex, p_union );
+    }
 
     // Iterate over every possible combination of p1 and p2
     // Complexity is approx. (N/2)^2 in the list of regions. I'm not proud of it.
@@ -198,17 +225,19 @@ mergeEncodedPatterns( vouw_t* v, pattern_t* p1, pattern_t* p2, int variant, patt
                 assert( r1->pattern->offsets[0].col == 0 && r1->pattern->offsets[0].row == 0 &&
                         p2->offsets[0].col == 0 && p1->offsets[0].row == 0 );
 
-                rfca_coord_t pivot = r1->pivot;
+                rfca_coord_t pivot = pattern_offset_abs( r1->pivot, anchor );
+                vn = (vn + anchor.value) % base;
                 // Fix the list iterators if we're removing r1 and r2
                 if( tmp1 == &r2->list )
                     tmp1 = r2->list.next;
                 if( tmp2 == &r1->list )
                     tmp2 = r1->list.next;
                 // Create a new region at this pivot containing p_union
-                region_t* region = (region_t*)malloc( sizeof( region_t ) );
+                region_t* region = allocRegion( v );
                 region->pivot =pivot;
                 region->pattern =p_union;
                 region->variant =vn;
+                region->masked =false;
                 
                 //list_add( &(region->list), &(v->encoded->list) );
                 list_add( &(region->list), &(r1->list) );
@@ -216,10 +245,10 @@ mergeEncodedPatterns( vouw_t* v, pattern_t* p1, pattern_t* p2, int variant, patt
                 // Remove and free both r1 and r2
                 r1->pattern->usage--;
                 list_del( &(r1->list) );
-                region_free( r1 );
+                releaseRegion( v, r1 );
                 r2->pattern->usage--;
                 list_del( &(r2->list) );
-                region_free( r2 );
+                releaseRegion( v, r2 );
 
 
                 p_union->usage ++;
@@ -244,6 +273,7 @@ prunePattern( vouw_t* v, pattern_t* p ) {
 
     // Usage is zero, removing anyway
     if( p->usage == 0 ) {
+        pattern_index_remove( v->ctIndex, p );
         list_del( &(p->list) );
         pattern_free( p );
         return;
@@ -260,7 +290,7 @@ prunePattern( vouw_t* v, pattern_t* p ) {
     // The number of singleton regions that will be encoded
     int d = p->usage * p->size;
     int u = d + v->singleton->usage;
-    gain -= -log2( (double)u / (double)v->rfca->buffer->nodeCount ) * (u+1);
+    gain -= -log2( (double)u / (double)v->nodeCount ) * (u+1);
     // Extra pivots and variants that are needed
     gain -= (v->stdBitsPerPivot + v->stdBitsPerVariant) * d;
 
@@ -270,37 +300,54 @@ prunePattern( vouw_t* v, pattern_t* p ) {
 
 }
 
-vouw_t*
-vouw_createFrom( rfca_t* r ) {
-    // We're creating an encoded version of r using a standard code table
-    vouw_t* v = (vouw_t*)malloc( sizeof( vouw_t ) );
-    v->buffer = NULL;
+/*
+ * Merge p1 and p2 as vouw_encodeStep() does once it has chosen them, returns their union
+ */
+static pattern_t*
+applyMerge( vouw_t* v, pattern_t* p1, pattern_t* p2, int variant, pattern_offset_t p2_offset ) {
+    pattern_t* p_union = mergeEncodedPatterns( v, p1, p2, variant, p2_offset );
+
+    updateEncodedLength( v );
+    
+    prunePattern( v, p1 );
+    if( p1 != p2 )
+        prunePattern( v, p2 );
+    return p_union;
+}
+
+/*
+ * Encode every node of r from first to last, inclusive in logical coordinates, as a region of the
+ * singleton pattern, which is the only pattern in the code table. The code table and the encoding of v must be empty.
+ */
+static void
+standardEncodingWindow( vouw_t* v, const rfca_t* r, rfca_coord_t first, rfca_coord_t last ) {
     v->rfca =r;
 
     // The initial code table contains only one pattern
-    v->codeTable = (pattern_t*)malloc( sizeof( pattern_t ) );
-    INIT_LIST_HEAD( &(v->codeTable->list) );
-    v->codeTable->size =0;
-    pattern_t* p0 = pattern_createSingle( 0 );
+    pattern_t* p0 = v->singleton;
+    if( !p0 )
+        p0 = v->singleton = pattern_createSingle( 0 );
+    p0->usage =0;
     list_add( &(p0->list), &(v->codeTable->list ) );
-    v->singleton = p0;
+    pattern_index_insert( v->ctIndex, p0 );
 
-    // The encoded data is represented in a linked list
-    v->encoded = (region_t*)malloc( sizeof( region_t ) );
-    v->encoded->pattern =NULL;
-    v->encoded->masked =false;
-    INIT_LIST_HEAD( &(v->encoded->list) );
-
-    // Now we encode each node in the automaton using the standard code table
-    for( int i =0; i < r->buffer->rowCount; i++ ) {
+    // Now we encode each node in the window using the standard code table
+    if( first.row < 0 ) first.row =0;
+    if( first.col < 0 ) first.col =0;
+    if( last.row >= r->buffer->rowCount ) last.row = r->buffer->rowCount - 1;
+    for( int i = first.row; i <= last.row; i++ ) {
         rfca_row_t* row = &r->buffer->rows[i];
-        for( int j =0; j < row->size; j++ ) {
+        const int end = last.col < row->size ? last.col + 1 : row->size;
+        for( int j = first.col; j < end; j++ ) {
 
             // Create a region for every singleton on every node
             rfca_coord_t pivot = { i,j };
             int value = rfca_value( r, pivot );
-            region_t* region = region_create( p0, pivot );
+            region_t* region = allocRegion( v );
+            region->pivot =pivot;
+            region->pattern =p0;
             region->variant = value;
+            region->masked =false;
 
             // Add to the encoded dataset
             list_add( &(region->list), &(v->encoded->list) );
@@ -309,61 +356,454 @@ vouw_createFrom( rfca_t* r ) {
             p0->usage++;
         }
     }
+    v->nodeCount = p0->usage;
 
     // Compute the initial encoding sizes for the data and the code table
     computeStdBits( v );
     updateEncodedLength( v );
-    return v;
 }
 
-vouw_t*
-vouw_createEncodedUsing( rfca_t* r, pattern_t* codeTable ) {
-    // We're creating an encoded version of r using a given code table
+/*
+ * Encode every node of r as a region of the singleton pattern
+ */
+static void
+standardEncoding( vouw_t* v, const rfca_t* r ) {
+    rfca_coord_t first = { 0, 0 }, last = { r->buffer->rowCount - 1, r->buffer->width - 1 };
+    standardEncodingWindow( v, r, first, last );
+}
+
+/*
+ * Allocate a vouw_t with an empty code table and encoding
+ */
+static vouw_t*
+vouw_alloc( const rfca_t* r ) {
     vouw_t* v = (vouw_t*)malloc( sizeof( vouw_t ) );
     v->buffer = NULL;
+    v->bufferCapacity =0;
+    v->keepBuffer =false;
     v->rfca =r;
+    v->nodeCount = r->buffer->nodeCount;
+    v->singleton =NULL;
+    v->log =NULL;
+    INIT_LIST_HEAD( &v->spare );
 
-    // Copy the code table to the newly created object
     v->codeTable = (pattern_t*)malloc( sizeof( pattern_t ) );
     INIT_LIST_HEAD( &(v->codeTable->list) );
+    v->codeTable->size =0;
+    v->ctIndex = pattern_index_create( 16 );
 
-    struct list_head* pos;
-    list_for_each( pos, &(codeTable->list) ) {
-        pattern_t* tmp = list_entry( pos, pattern_t, list );
-        pattern_t* p =pattern_createCopy( tmp );
-        p->usage =0;
-        list_add( &(p->list), &(v->codeTable->list) );
+    // The encoded data is represented in a linked list
+    v->encoded = (region_t*)malloc( sizeof( region_t ) );
+    v->encoded->pattern =NULL;
+    v->encoded->masked =false;
+    INIT_LIST_HEAD( &(v->encoded->list) );
+    return v;
+}
+
+vouw_t*
+vouw_createFrom( const rfca_t* r ) {
+    // We're creating an encoded version of r using a standard code table
+    vouw_t* v = vouw_alloc( r );
+    standardEncoding( v, r );
+    return v;
+}
+
+/*
+ * Create the encoding of r that consists of the patterns in codeTable and the regions in encoded, such as one
+ * that was read from a file (see codec_readEncoding()). Both lists are moved into the returned encoding
+ * and their heads are freed. The nodes of r are not read, so it may hold only its shape (see rfca_createShape()).
+ */
+vouw_t*
+vouw_createEncodedWith( const rfca_t* r, pattern_t* codeTable, region_t* encoded ) {
+    vouw_t* v = vouw_alloc( r );
+    struct list_head* tmp,* pos;
+    list_for_each_safe( pos, tmp, &(codeTable->list) ) {
+        pattern_t* p = list_entry( pos, pattern_t, list );
+        list_move_tail( pos, &(v->codeTable->list) );
+        pattern_index_insert( v->ctIndex, p );
         if( p->size == 1 )
             v->singleton = p;
     }
+    list_splice( &(encoded->list), &(v->encoded->list) );
+    free( codeTable );
+    free( encoded );
 
-    // The code table has to be sorted descending by pattern size
-    pattern_list_sortBySizeDesc( v->codeTable );
+    computeStdBits( v );
+    updateEncodedLength( v );
+    return v;
+}
 
-    // The encoded data is represented in a linked list
-    v->encoded = (region_t*)malloc( sizeof( region_t ) );
-    INIT_LIST_HEAD( &(v->encoded->list) );
+/*
+ * Create the standard encoding of only the nodes of r from first to last, inclusive in logical coordinates,
+ * so that vouw_encode() mines the patterns of that window alone. Lengths are computed as if the window
+ * was the entire automaton. Returns NULL if the window holds no nodes.
+ */
+vouw_t*
+vouw_createFromWindow( const rfca_t* r, rfca_coord_t first, rfca_coord_t last ) {
+    vouw_t* v = vouw_alloc( r );
+    standardEncodingWindow( v, r, first, last );
+    if( v->nodeCount == 0 ) {
+        vouw_free( v );
+        return NULL;
+    }
+    return v;
+}
 
-    // Encode the automaton by running each code table pattern over the output buffer
-    list_for_each( pos, &(v->codeTable->list) ) {
+/*
+ * Combine the code tables of several encodings into one, such as those of the tiles of an automaton.
+ * Patterns of the same shape are combined and their usages added. The returned list holds copies
+ * in order of first appearance and must be freed with pattern_list_free().
+ */
+pattern_t*
+vouw_mergeCodeTables( vouw_t* const* vs, int count ) {
+    pattern_t* list = (pattern_t*)malloc( sizeof( pattern_t ) );
+    INIT_LIST_HEAD( &(list->list) );
+    list->size =0;
+    pattern_index_t* idx = pattern_index_create( 16 );
+
+    for( int i =0; i < count; i++ ) {
+        struct list_head* pos;
+        list_for_each( pos, &(vs[i]->codeTable->list) ) {
+            const pattern_t* p = list_entry( pos, pattern_t, list );
+            pattern_t* existing = pattern_index_find( idx, p );
+            if( existing ) {
+                existing->usage += p->usage;
+                continue;
+            }
+            pattern_t* copy = pattern_createCopy( p );
+            list_add_tail( &(copy->list), &(list->list) );
+            pattern_index_insert( idx, copy );
+        }
+    }
+    pattern_index_free( idx );
+    return list;
+}
+
+/*
+ * Start over with the standard encoding of r, as vouw_createFrom() would, but reuse the memory of v.
+ * r is usually an automaton of the same class that was regenerated with rfca_reset().
+ * From now on v keeps its candidate buffer after vouw_encode(), so repeatedly encoding
+ * automata of the same size does not allocate it again.
+ */
+void
+vouw_reset( vouw_t* v, const rfca_t* r ) {
+    v->keepBuffer =true;
+
+    struct list_head* tmp,* pos;
+    list_for_each_safe( pos, tmp, &(v->encoded->list) ) {
+        list_del( pos );
+        releaseRegion( v, list_entry( pos, region_t, list ) );
+    }
+    list_for_each_safe( pos, tmp, &(v->codeTable->list) ) {
+        pattern_t* pattern = list_entry( pos, pattern_t, list );
+        list_del( pos );
+        if( pattern != v->singleton )
+            pattern_free( pattern );
+    }
+    pattern_index_clear( v->ctIndex );
+
+    standardEncoding( v, r );
+}
+
+/*
+ * Make sure s can hold a code table of n patterns and rowmasks bitboard row masks
+ */
+static void
+scratch_reserve( vouw_scratch_t* s, int n, int rowmasks ) {
+    if( n > s->patternCapacity ) {
+        s->patternCapacity = n * 2;
+        s->patterns = (const pattern_t**)realloc( s->patterns, sizeof( pattern_t* ) * s->patternCapacity );
+        s->usage = (unsigned int*)realloc( s->usage, sizeof( unsigned int ) * s->patternCapacity );
+        s->bps = (bitboard_pattern_t*)realloc( s->bps, sizeof( bitboard_pattern_t ) * s->patternCapacity );
+    }
+    if( rowmasks > s->rowmaskCapacity ) {
+        s->rowmaskCapacity = rowmasks * 2;
+        s->rowmasks = (bitboard_rowmask_t*)realloc( s->rowmasks, sizeof( bitboard_rowmask_t ) * s->rowmaskCapacity );
+    }
+}
+
+static bool
+sameShape( int rowCount, const int* rowSize, int nodeCount, int rowCount2, const int* rowSize2, int nodeCount2 ) {
+    if( rowCount != rowCount2 || nodeCount != nodeCount2 )
+        return false;
+    for( int i =0; i < rowCount; i++ )
+        if( rowSize[i] != rowSize2[i] )
+            return false;
+    return true;
+}
+
+/*
+ * Prepare s for covering t with codeTable and return the number of patterns.
+ * s->patterns receives the code table in encoding order, which is the order
+ * of a copied and sorted code table: descending by size, equal sizes in reverse list order.
+ */
+static int
+scratch_prepare( vouw_scratch_t* s, const vouw_target_t* t, const pattern_t* codeTable ) {
+    int n =0, rowmasks =0;
+    struct list_head* pos;
+    list_for_each( pos, &(codeTable->list) ) {
         pattern_t* p = list_entry( pos, pattern_t, list );
-        pattern_bounds_t pb = pattern_computeBounds( p );
-        
-        //for( int i =0/*-pb.rowMin*/; i < r->buffer->rowCount /*- pb.rowMax*/; i++ ) {
-         //   for( int j =0/*-pb.colMin*/; j < rfca_rowLength( r, i ) /*- pb.colMax*/; j++ ) {
-        for( int i = r->buffer->rowCount -1; i >= 0; i-- ) {
-            for( int j = rfca_rowLength( r, i ) -1; j>= 0; j-- ) {
-                rfca_coord_t pivot = { i,j };
-                int variant =0;
-                if( pattern_isMatch( p, r, pivot, &variant ) ) {
-                    createRegion( v, p, pivot, variant, true );
-                    p->usage++;
+        rowmasks += p->size;
+        n++;
+    }
+    scratch_reserve( s, n, rowmasks );
+
+    // Insertion sort, stable with respect to the reversed list
+    int k =0;
+    list_for_each( pos, &(codeTable->list) ) {
+        const pattern_t* p = list_entry( pos, pattern_t, list );
+        int j = k++;
+        while( j > 0 && s->patterns[j-1]->size <= p->size ) {
+            s->patterns[j] = s->patterns[j-1];
+            j--;
+        }
+        s->patterns[j] = p;
+    }
+    for( int i =0; i < n; i++ )
+        s->usage[i] =0;
+
+    if( t->bits ) {
+        bitboard_rowmask_t* rows = s->rowmasks;
+        for( int i =0; i < n; i++ ) {
+            bitboard_pattern_initWith( &s->bps[i], s->patterns[i], rows );
+            rows += s->patterns[i]->size;
+        }
+        if( s->bitsMask && !sameShape( s->bitsMask->rowCount, s->bitsMask->rowSize, s->bitsMask->nodeCount,
+                                       t->bits->rowCount, t->bits->rowSize, t->bits->nodeCount ) ) {
+            bitboard_free( s->bitsMask );
+            s->bitsMask = NULL;
+        }
+        if( s->bitsMask )
+            bitboard_clear( s->bitsMask );
+        else
+            s->bitsMask = bitboard_createLike( t->bits );
+    } else {
+        if( s->planeMask && !sameShape( s->planeMask->rowCount, s->planeMask->rowSize, s->planeMask->nodeCount,
+                                        t->plane->rowCount, t->plane->rowSize, t->plane->nodeCount ) ) {
+            match_plane_free( s->planeMask );
+            s->planeMask = NULL;
+        }
+        if( s->planeMask )
+            match_plane_clear( s->planeMask );
+        else
+            s->planeMask = match_plane_createLike( t->plane );
+    }
+    return n;
+}
+
+/*
+ * Returns true if the cover after pattern k certainly needs more than maxRegions regions.
+ * Every node is covered by exactly one region and the patterns after k are at most as large
+ * as pattern k+1, so the nodes that are left need at least uncovered/size more regions.
+ */
+static bool
+cover_exceeds( const vouw_scratch_t* s, int n, int k, uint64_t regions, uint64_t uncovered, uint64_t maxRegions ) {
+    if( k+1 >= n || maxRegions == UINT64_MAX )
+        return false;
+    const uint64_t size = s->patterns[k+1]->size;
+    return regions + (uncovered + size - 1) / size > maxRegions;
+}
+
+/*
+ * Greedily cover a match plane with the patterns in s, in encoding order.
+ * Each pattern is tried on every pivot, starting at the last node,
+ * and every match that does not overlap an earlier one is counted in s->usage.
+ * If v is given, a region with pattern owned[k] is created for every match of s->patterns[k].
+ * Returns false if the cover was given up because it would need more than maxRegions regions.
+ */
+static bool
+coverWithPlane( const match_plane_t* plane, vouw_scratch_t* s, int n, vouw_t* v, pattern_t* const* owned, uint64_t maxRegions ) {
+    match_plane_t* mask = s->planeMask;
+    const int lanes = match_laneCount();
+    uint64_t regions =0, uncovered = plane->nodeCount;
+
+    for( int k =0; k < n; k++ ) {
+        const pattern_t* p = s->patterns[k];
+
+        // Pivots are visited from the last node to the first, a run of pivots at a time
+        for( int i = plane->rowCount -1; i >= 0; i-- ) {
+            int first, last;
+            if( !pattern_rowBounds( p, plane->rowSize, plane->rowCount, i, &first, &last ) )
+                continue;
+
+            for( int end = last; end >= first; end -= lanes ) {
+                int col = end - lanes + 1 < first ? first : end - lanes + 1;
+                int count = end - col + 1;
+                uint32_t matches = match_row( p, plane, mask, i, col, count );
+                bool dirty =false;
+
+                for( int l = count-1; l >= 0; l-- ) {
+                    if( !(matches & (1u << l)) )
+                        continue;
+                    rfca_coord_t pivot = { i, col + l };
+                    // A region accepted earlier in this run may overlap this pivot
+                    if( dirty && !match_isFree( p, mask, pivot ) )
+                        continue;
+                    if( v )
+                        createRegion( v, owned[k], pivot, match_variant( p, plane, pivot ) );
+                    match_setMasked( p, mask, pivot );
+                    s->usage[k]++;
+                    dirty =true;
                 }
             }
         }
+        regions += s->usage[k];
+        uncovered -= (uint64_t)s->usage[k] * p->size;
+        if( cover_exceeds( s, n, k, regions, uncovered, maxRegions ) )
+            return false;
+    }
+    return true;
+}
 
+/*
+ * Same as coverWithPlane(), for base-2 automata stored as bitboards
+ */
+static bool
+coverWithBitboard( const bitboard_t* bb, vouw_scratch_t* s, int n, vouw_t* v, pattern_t* const* owned, uint64_t maxRegions ) {
+    bitboard_t* mask = s->bitsMask;
+    uint64_t regions =0, uncovered = bb->nodeCount;
+
+    for( int k =0; k < n; k++ ) {
+        const pattern_t* p = s->patterns[k];
+        const bitboard_pattern_t* bp = &s->bps[k];
+
+        for( int i = bb->rowCount -1; i >= 0; i-- ) {
+            int first, last;
+            if( !pattern_rowBounds( p, bb->rowSize, bb->rowCount, i, &first, &last ) )
+                continue;
+
+            for( int end = last; end >= first; end -= BITBOARD_LANES ) {
+                int col = end - BITBOARD_LANES + 1 < first ? first : end - BITBOARD_LANES + 1;
+                int count = end - col + 1;
+                uint64_t variants;
+                uint64_t matches = bitboard_matchRow( bp, bb, mask, i, col, count, &variants );
+                bool dirty =false;
+
+                while( matches ) {
+                    int l = 63 - __builtin_clzll( matches );
+                    matches &= ~(1ULL << l);
+                    rfca_coord_t pivot = { i, col + l };
+                    if( dirty && !bitboard_isFree( bp, mask, pivot ) )
+                        continue;
+                    if( v )
+                        createRegion( v, owned[k], pivot, (variants >> l) & 1 );
+                    bitboard_setMasked( bp, mask, pivot );
+                    s->usage[k]++;
+                    dirty =true;
+                }
+            }
+        }
+        regions += s->usage[k];
+        uncovered -= (uint64_t)s->usage[k] * p->size;
+        if( cover_exceeds( s, n, k, regions, uncovered, maxRegions ) )
+            return false;
     }
-    rfca_unmaskAll( r );
+    return true;
+}
+
+static bool
+cover( const vouw_target_t* t, vouw_scratch_t* s, int n, vouw_t* v, pattern_t* const* owned, uint64_t maxRegions ) {
+    if( t->bits )
+        return coverWithBitboard( t->bits, s, n, v, owned, maxRegions );
+    return coverWithPlane( t->plane, s, n, v, owned, maxRegions );
+}
+
+/*
+ * Prepare r for cross-encoding with vouw_createEncodedUsingTarget().
+ * r must not be modified or freed as long as the target is in use.
+ */
+vouw_target_t*
+vouw_target_create( const rfca_t* r ) {
+    vouw_target_t* t = (vouw_target_t*)malloc( sizeof( vouw_target_t ) );
+    t->rfca =r;
+    t->plane =NULL;
+    t->bits =NULL;
+    if( r->opts.base == 2 )
+        t->bits = bitboard_createFrom( r );
+    else
+        t->plane = match_plane_create( r );
+    return t;
+}
+
+/*
+ * Make t a target for r, which must have the same size as the automaton t was created for
+ */
+void
+vouw_target_reset( vouw_target_t* t, const rfca_t* r ) {
+    t->rfca =r;
+    if( t->bits )
+        bitboard_copyFrom( t->bits, r );
+    else
+        match_plane_copyFrom( t->plane, r );
+}
+
+void
+vouw_target_free( vouw_target_t* t ) {
+    if( t->plane )
+        match_plane_free( t->plane );
+    if( t->bits )
+        bitboard_free( t->bits );
+    free( t );
+}
+
+vouw_scratch_t*
+vouw_scratch_create( void ) {
+    vouw_scratch_t* s = (vouw_scratch_t*)calloc( 1, sizeof( vouw_scratch_t ) );
+    return s;
+}
+
+void
+vouw_scratch_free( vouw_scratch_t* s ) {
+    if( s->planeMask )
+        match_plane_free( s->planeMask );
+    if( s->bitsMask )
+        bitboard_free( s->bitsMask );
+    free( s->patterns );
+    free( s->usage );
+    free( s->bps );
+    free( s->rowmasks );
+    free( s );
+}
+
+vouw_t*
+vouw_createEncodedUsing( const rfca_t* r, const pattern_t* codeTable ) {
+    vouw_target_t* t = vouw_target_create( r );
+    vouw_t* v = vouw_createEncodedUsingTarget( t, codeTable );
+    vouw_target_free( t );
+    return v;
+}
+
+/*
+ * Create an encoded version of t's automaton using a given code table.
+ * Neither t nor codeTable are modified, so this function can be called
+ * concurrently for the same target and/or code table.
+ */
+vouw_t*
+vouw_createEncodedUsingTarget( const vouw_target_t* t, const pattern_t* codeTable ) {
+    // We're creating an encoded version of r using a given code table
+    vouw_t* v = vouw_alloc( t->rfca );
+
+    vouw_scratch_t* s = vouw_scratch_create();
+    int n = scratch_prepare( s, t, codeTable );
+
+    // Copy the code table to the newly created object, in encoding order
+    pattern_t** owned = (pattern_t**)malloc( sizeof( pattern_t* ) * n );
+
+    for( int k =0; k < n; k++ ) {
+        pattern_t* p =pattern_createCopy( s->patterns[k] );
+        list_add_tail( &(p->list), &(v->codeTable->list) );
+        pattern_index_insert( v->ctIndex, p );
+        if( p->size == 1 )
+            v->singleton = p;
+        owned[k] = p;
+    }
+
+    // Encode the automaton by running each code table pattern over the output buffer
+    cover( t, s, n, v, owned, UINT64_MAX );
+    for( int k =0; k < n; k++ )
+        owned[k]->usage = s->usage[k];
+    free( owned );
+    vouw_scratch_free( s );
     
     // Compute the encoding sizes for the data and the code table
     computeStdBits( v );
@@ -371,9 +811,78 @@ vouw_createEncodedUsing( rfca_t* r, pattern_t* codeTable ) {
     return v; 
 }
 
+/*
+ * Compute the MDL encoding length of t's automaton using a given code table, in bits.
+ * This performs the same cover as vouw_createEncodedUsingTarget() and yields the same
+ * ctBits and encodedBits, but only the usage of each pattern is counted: no regions or
+ * pattern copies are created and no memory is allocated once s is large enough.
+ * ctBits and encodedBits may be NULL.
+ */
+double
+vouw_crossEncodedLength( const vouw_target_t* t, const pattern_t* codeTable, vouw_scratch_t* s, double* ctBits, double* encodedBits ) {
+    return vouw_crossEncodedLengthBounded( t, codeTable, s, INFINITY, ctBits, encodedBits );
+}
+
+/*
+ * Same as vouw_crossEncodedLength(), but the cover is given up as soon as the length
+ * is certain to exceed bound, in which case INFINITY is returned and ctBits and encodedBits are not set.
+ * The length without the cost of the pattern usages, which are not known before the cover has finished,
+ * is at least the size of the code table plus the pivot and variant of every region.
+ */
+double
+vouw_crossEncodedLengthBounded( const vouw_target_t* t, const pattern_t* codeTable, vouw_scratch_t* s, double bound,
+                                double* ctBits, double* encodedBits ) {
+    const int n = scratch_prepare( s, t, codeTable );
+
+    // Same computation as computeStdBits() and updateEncodedLength()
+    const int nodeCount = t->rfca->buffer->nodeCount;
+    const double stdBitsPerOffset = log2( (double)nodeCount ) + log2( t->rfca->opts.base );
+    const double stdBitsPerPivot = log2( (double)nodeCount );
+    const double stdBitsPerVariant = log2( (double)t->rfca->opts.base );
+    double ct =0.0, encoded =0.0;
+
+    uint64_t maxRegions = UINT64_MAX;
+    if( bound != INFINITY ) {
+        double minCt =0.0;
+        for( int k =0; k < n; k++ )
+            minCt += stdBitsPerOffset * s->patterns[k]->size;
+        const double regions = (bound - minCt) / (stdBitsPerPivot + stdBitsPerVariant);
+        if( regions < 0.0 )
+            return INFINITY;
+        if( regions < (double)nodeCount )
+            maxRegions = (uint64_t)regions;
+    }
+    if( !cover( t, s, n, NULL, NULL, maxRegions ) )
+        return INFINITY;
+
+    for( int k =0; k < n; k++ ) {
+        const double codeLength = s->usage[k] == 0 ? 0.0 : -log2( (double)s->usage[k] / (double)nodeCount );
+        ct += codeLength + stdBitsPerOffset * s->patterns[k]->size;
+    }
+    // Regions are summed one at a time in the order in which computeEncodedBits() visits them,
+    // last pattern first, so the total is identical to that of the full encoding
+    for( int k = n-1; k >= 0; k-- ) {
+        const double codeLength = s->usage[k] == 0 ? 0.0 : -log2( (double)s->usage[k] / (double)nodeCount );
+        const double regionBits = codeLength + stdBitsPerPivot + stdBitsPerVariant;
+        for( unsigned int u =0; u < s->usage[k]; u++ )
+            encoded += regionBits;
+    }
+    if( ctBits )
+        *ctBits = ct;
+    if( encodedBits )
+        *encodedBits = encoded;
+    return ct + encoded;
+}
+
 void
 vouw_free( vouw_t* v ) {
     region_list_free( v->encoded );
+    struct list_head* tmp,* pos;
+    list_for_each_safe( pos, tmp, &v->spare ) {
+        list_del( pos );
+        region_free( list_entry( pos, region_t, list ) );
+    }
+    pattern_index_free( v->ctIndex );
     pattern_list_free( v->codeTable );
     if( v->buffer )
         free( v->buffer );
@@ -383,10 +892,12 @@ vouw_free( vouw_t* v ) {
 static void
 candidates_alloc( vouw_t* v ) {
     v->bufferIndex =0;
-    if( !v->buffer ) {
-        int maxOffsets = v->rfca->buffer->nodeCount;
-        maxOffsets *= maxOffsets;
+    uint64_t maxOffsets = v->nodeCount;
+    maxOffsets *= maxOffsets;
+    if( !v->buffer || v->bufferCapacity < maxOffsets ) {
+        free( v->buffer );
         v->buffer = malloc( maxOffsets * sizeof( candidate_t ) );
+        v->bufferCapacity = maxOffsets;
     }
 }
 
@@ -426,7 +937,16 @@ int
 vouw_encode( vouw_t* v ) {
     int steps =0;
     while( vouw_encodeStep( v ) ) steps++;
+    if( v->log )
+        mergelog_finish( v->log );
 
+    // The candidate buffer is quadratic in the number of nodes, don't keep it around
+    // unless v is going to be reused (see vouw_reset())
+    if( !v->keepBuffer ) {
+        free( v->buffer );
+        v->buffer =NULL;
+        v->bufferCapacity =0;
+    }
     return steps;
 }
 
@@ -479,7 +999,9 @@ vouw_encodeStep( vouw_t* v ) {
     for( int i =0; i < candidates_count( v ); i++ ) {
         candidate_t c =candidates_index( v, i );
 
-        double gain = computeGain( v, c.p1, c.p2, c.usage );
+        pattern_offset_t offset = { c.row, c.col, 0 };
+        const pattern_t* existing = pattern_index_findUnion( v->ctIndex, c.p1, c.p2, c.variant, offset, base );
+        double gain = computeGain( v, c.p1, c.p2, c.usage, existing );
         if( gain >= bestGain ) {
             bestGain =gain;
             bestP2Offset.col= c.col;
@@ -504,25 +1026,223 @@ vouw_encodeStep( vouw_t* v ) {
     fprintf( stderr,"vouw_step(): compression size gain: %f bits\n", bestGain );
 #endif
 
-    mergeEncodedPatterns( v, bestP1, bestP2, bestVar, bestP2Offset );
+    mergelog_entry_t e;
+    if( v->log ) {
+        pattern_list_setIndices( v->codeTable );
+        e.p1 = bestP1->index;
+        e.p2 = bestP2->index;
+        e.row = bestP2Offset.row;
+        e.col = bestP2Offset.col;
+        e.variant = bestVar;
+    }
 
-    updateEncodedLength( v );
-    
-    prunePattern( v, bestP1 );
-    if( bestP1 != bestP2 )
-        prunePattern( v, bestP2 );
-    
+    pattern_t* p_union = applyMerge( v, bestP1, bestP2, bestVar, bestP2Offset );
+
+    if( v->log ) {
+        pattern_list_setIndices( v->codeTable );
+        e.created = p_union->index;
+        mergelog_append( v->log, &e );
+    }
     return true;
 }
 
-rfca_t*
-vouw_decode( vouw_t* v ) {
+/*
+ * Apply the merges of log to v, which must hold the standard encoding of the automaton the log was written for.
+ * The code table and the encoding end up as after the same steps of vouw_encodeStep(), without searching
+ * for candidates. The merges are appended to v->log, unless that is log itself.
+ * Returns the number of merges that were applied, which is less than log->count
+ * if a merge does not match the code table of v.
+ */
+uint64_t
+vouw_replay( vouw_t* v, const mergelog_t* log ) {
+    const int base = v->rfca->opts.base;
+    const rfca_buffer_t* b = v->rfca->buffer;
+    pattern_t** patterns =NULL;
+    int capacity =0;
+    uint64_t i;
+
+    for( i =0; i < log->count; i++ ) {
+        const mergelog_entry_t* e = &log->entries[i];
+        const int n = pattern_list_setIndices( v->codeTable );
+        if( e->p1 < 0 || e->p1 >= n || e->p2 < 0 || e->p2 >= n || e->variant < 0 || e->variant >= base ||
+            abs( e->row ) >= b->rowCount || abs( e->col ) >= b->width )
+            break;
+        if( n > capacity ) {
+            capacity = n * 2;
+            patterns = (pattern_t**)realloc( patterns, sizeof( pattern_t* ) * capacity );
+        }
+        struct list_head* pos;
+        list_for_each( pos, &(v->codeTable->list) ) {
+            pattern_t* p = list_entry( pos, pattern_t, list );
+            patterns[p->index] = p;
+        }
+
+        pattern_offset_t offset = { e->row, e->col, 0 };
+        pattern_t* p_union = applyMerge( v, patterns[e->p1], patterns[e->p2], e->variant, offset );
+
+        pattern_list_setIndices( v->codeTable );
+        if( p_union->index != e->created )
+            break;
+        if( v->log && v->log != log )
+            mergelog_append( v->log, e );
+    }
+    free( patterns );
+    return i;
+}
+
+/*
+ * Decode a base-2 encoding by writing each region's per-row bit masks to a bitboard
+ */
+static rfca_t*
+decodeBitboard( vouw_t* v ) {
     rfca_t* r = rfca_create( v->rfca->opts );
+    bitboard_t* bb = bitboard_create( r->buffer );
+
+    int n = pattern_list_setIndices( v->codeTable );
+    bitboard_pattern_t* bps = (bitboard_pattern_t*)malloc( sizeof( bitboard_pattern_t ) * n );
     struct list_head* pos;
+    list_for_each( pos, &(v->codeTable->list) ) {
+        pattern_t* p = list_entry( pos, pattern_t, list );
+        bitboard_pattern_init( &bps[p->index], p );
+    }
+
     list_for_each( pos, &(v->encoded->list) ) {
         region_t* region = list_entry( pos, region_t, list );
+        bitboard_apply( &bps[region->pattern->index], bb, region->pivot, region->variant );
+    }
+    bitboard_copyTo( bb, r );
+
+    for( int i =0; i < n; i++ )
+        bitboard_pattern_destroy( &bps[i] );
+    free( bps );
+    bitboard_free( bb );
+    return r;
+}
 
-        region_apply( region, r );
+// Number of rows that are decoded together by one worker
+#define DECODE_BAND 32
+
+/* Offsets of a pattern relative to the internal column of its pivot, so that regions
+ * can be written to the row buffers directly, without transposing every node */
+typedef struct {
+    pattern_offset_t* offsets;
+    int size;
+    int rowMin;
+    int rowMax;
+} decode_pattern_t;
+
+typedef struct {
+    rfca_t* r;
+    decode_pattern_t* patterns;
+    const region_t** regions;   // regions per band, sorted by band
+    uint64_t* bandStart;        // first index in regions of each band, bandCount+1 entries
+} decode_ctx_t;
+
+static void
+decode_band( void* arg, uint64_t band, int worker ) {
+    (void)worker;
+    decode_ctx_t* ctx = (decode_ctx_t*)arg;
+    rfca_row_t* rows = ctx->r->buffer->rows;
+    const bool right = ctx->r->opts.right;
+    const int base = ctx->r->opts.base;
+    const int first = band * DECODE_BAND;
+    const int last = first + DECODE_BAND; // exclusive
+
+    for( uint64_t i = ctx->bandStart[band]; i < ctx->bandStart[band+1]; i++ ) {
+        const region_t* region = ctx->regions[i];
+        const decode_pattern_t* dp = &ctx->patterns[region->pattern->index];
+        const int row = region->pivot.row;
+        const int col = right ? region->pivot.col : rows[row].size - 1 - region->pivot.col;
+
+        if( row + dp->rowMin >= first && row + dp->rowMax < last ) {
+            // The region lies within this band, all of its offsets are written
+            for( int j =0; j < dp->size; j++ ) {
+                const pattern_offset_t o = dp->offsets[j];
+                rows[row + o.row].cols[col + o.col] = (o.value + region->variant) % base;
+            }
+        } else {
+            // The region spans multiple bands, only the rows of this band are written
+            for( int j =0; j < dp->size; j++ ) {
+                const pattern_offset_t o = dp->offsets[j];
+                if( row + o.row < first || row + o.row >= last ) continue;
+                rows[row + o.row].cols[col + o.col] = (o.value + region->variant) % base;
+            }
+        }
+    }
+}
+
+/*
+ * Decode the encoding in bands of DECODE_BAND rows that are written by up to the given number of threads.
+ * Regions never overlap, so different bands can be written without synchronization.
+ */
+rfca_t*
+vouw_decodeParallel( vouw_t* v, int threads ) {
+    // On a single thread, base-2 encodings are decoded faster a machine word at a time
+    if( threads <= 1 && v->rfca->opts.base == 2 )
+        return decodeBitboard( v );
+
+    rfca_t* r = rfca_create( v->rfca->opts );
+    const int mirror = r->opts.right ? 0 : r->buffer->mode - 1;
+
+    // Translate the offsets of each pattern to internal columns
+    int n = pattern_list_setIndices( v->codeTable );
+    decode_pattern_t* dps = (decode_pattern_t*)malloc( sizeof( decode_pattern_t ) * n );
+    struct list_head* pos;
+    list_for_each( pos, &(v->codeTable->list) ) {
+        pattern_t* p = list_entry( pos, pattern_t, list );
+        decode_pattern_t* dp = &dps[p->index];
+        pattern_bounds_t pb = pattern_computeBounds( p );
+        dp->size = p->size;
+        dp->rowMin = pb.rowMin;
+        dp->rowMax = pb.rowMax;
+        dp->offsets = (pattern_offset_t*)malloc( sizeof( pattern_offset_t ) * p->size );
+        for( unsigned int i =0; i < p->size; i++ ) {
+            dp->offsets[i] = p->offsets[i];
+            // Row i is shorter than row 0 by i*(mode-1) nodes, which shifts mirrored columns
+            if( !r->opts.right )
+                dp->offsets[i].col = -p->offsets[i].col - p->offsets[i].row * mirror;
+        }
     }
+
+    // Counting sort of the regions by band, a region is added to every band its rows overlap
+    const uint64_t bandCount = (r->buffer->rowCount + DECODE_BAND - 1) / DECODE_BAND;
+    uint64_t* bandStart = (uint64_t*)calloc( bandCount + 1, sizeof( uint64_t ) );
+    list_for_each( pos, &(v->encoded->list) ) {
+        region_t* region = list_entry( pos, region_t, list );
+        const decode_pattern_t* dp = &dps[region->pattern->index];
+        for( int b = (region->pivot.row + dp->rowMin) / DECODE_BAND; b <= (region->pivot.row + dp->rowMax) / DECODE_BAND; b++ )
+            bandStart[b+1]++;
+    }
+    for( uint64_t b =0; b < bandCount; b++ )
+        bandStart[b+1] += bandStart[b];
+    const region_t** regions = (const region_t**)malloc( sizeof( region_t* ) * (bandStart[bandCount] + 1) );
+    uint64_t* fill = (uint64_t*)malloc( sizeof( uint64_t ) * (bandCount + 1) );
+    for( uint64_t b =0; b <= bandCount; b++ )
+        fill[b] = bandStart[b];
+    list_for_each( pos, &(v->encoded->list) ) {
+        region_t* region = list_entry( pos, region_t, list );
+        const decode_pattern_t* dp = &dps[region->pattern->index];
+        for( int b = (region->pivot.row + dp->rowMin) / DECODE_BAND; b <= (region->pivot.row + dp->rowMax) / DECODE_BAND; b++ )
+            regions[fill[b]++] = region;
+    }
+    free( fill );
+
+    decode_ctx_t ctx = { r, dps, regions, bandStart };
+    if( threads > (int)bandCount )
+        threads = bandCount;
+    if( threads < 1 )
+        threads =1;
+    sched_run( 0, bandCount, threads, decode_band, NULL, &ctx );
+
+    for( int i =0; i < n; i++ )
+        free( dps[i].offsets );
+    free( dps );
+    free( regions );
+    free( bandStart );
     return r;
 }
+
+rfca_t*
+vouw_decode( vouw_t* v ) {
+    return vouw_decodeParallel( v, 1 );
+}
@@ -13,12 +13,17 @@
 #include "rfca.h"
 #include "region.h"
 #include "pattern.h"
+#include "match.h"
+#include "bitboard.h"
+#include "mergelog.h"
 
 typedef struct {
     region_t* encoded;
     pattern_t* codeTable;
+    pattern_index_t* ctIndex; // canonical patterns in codeTable
     pattern_t* singleton;
-    rfca_t *rfca;
+    const rfca_t *rfca;
+    int nodeCount;              // number of nodes that are encoded, all nodes of rfca unless created from a window
     double encodedBits;
     double ctBits;
     double stdBitsPerOffset;
@@ -26,13 +31,78 @@ typedef struct {
     double stdBitsPerVariant;
     void* buffer;
     uint64_t bufferIndex;
+    uint64_t bufferCapacity;    // number of candidates that fit in buffer
+    bool keepBuffer;            // keep buffer after vouw_encode(), see vouw_reset()
+    struct list_head spare;     // regions that are no longer used, to be reused
+    mergelog_t* log;            // optional, every merge of vouw_encodeStep() is appended to it
 } vouw_t;
 
+/* Read-only form of an automaton that is to be cross-encoded.
+ * All mask state is kept per call, so one target can be encoded with different
+ * code tables from multiple threads at the same time.
+ */
+typedef struct {
+    const rfca_t* rfca;
+    match_plane_t* plane; // base > 2
+    bitboard_t* bits;     // base == 2
+} vouw_target_t;
+
+/* Working memory for vouw_crossEncodedLength(). It grows to the largest code table
+ * and target seen and is reused afterwards. A scratch must not be shared between threads.
+ */
+typedef struct {
+    const pattern_t** patterns;  // code table in encoding order
+    unsigned int* usage;         // usage of each pattern in patterns
+    bitboard_pattern_t* bps;     // patterns as bit masks, base == 2 only
+    bitboard_rowmask_t* rowmasks;
+    int patternCapacity;
+    int rowmaskCapacity;
+    match_plane_t* planeMask;
+    bitboard_t* bitsMask;
+} vouw_scratch_t;
+
+vouw_t*
+vouw_createFrom( const rfca_t* r );
+
+vouw_t*
+vouw_createEncodedWith( const rfca_t* r, pattern_t* codeTable, region_t* encoded );
+
+vouw_t*
+vouw_createFromWindow( const rfca_t* r, rfca_coord_t first, rfca_coord_t last );
+
+pattern_t*
+vouw_mergeCodeTables( vouw_t* const* vs, int count );
+
+void
+vouw_reset( vouw_t* v, const rfca_t* r );
+
 vouw_t*
-vouw_createFrom( rfca_t* r );
+vouw_createEncodedUsing( const rfca_t* r, const pattern_t* codeTable );
+
+vouw_target_t*
+vouw_target_create( const rfca_t* r );
+
+void
+vouw_target_reset( vouw_target_t* t, const rfca_t* r );
+
+void
+vouw_target_free( vouw_target_t* t );
 
 vouw_t*
-vouw_createEncodedUsing( rfca_t* r, pattern_t* codeTable );
+vouw_createEncodedUsingTarget( const vouw_target_t* t, const pattern_t* codeTable );
+
+vouw_scratch_t*
+vouw_scratch_create( void );
+
+void
+vouw_scratch_free( vouw_scratch_t* s );
+
+double
+vouw_crossEncodedLength( const vouw_target_t* t, const pattern_t* codeTable, vouw_scratch_t* s, double* ctBits, double* encodedBits );
+
+double
+vouw_crossEncodedLengthBounded( const vouw_target_t* t, const pattern_t* codeTable, vouw_scratch_t* s, double bound,
+                                double* ctBits, double* encodedBits );
 
 void
 vouw_free( vouw_t* v );
@@ -46,7 +116,13 @@ vouw_encode( vouw_t* v );
 int
 vouw_encodeStep( vouw_t* v );
 
+uint64_t
+vouw_replay( vouw_t* v, const mergelog_t* log );
+
 rfca_t*
 vouw_decode( vouw_t* v );
 
+rfca_t*
+vouw_decodeParallel( vouw_t* v, int threads );
+
 #endif